@@ -5,5 +5,6 @@
 
 uint64_t ui_pow_ui(uint64_t x, uint64_t n);
 uint64_t gcd(uint64_t a, uint64_t b);
+uint64_t binomial(uint64_t n, uint64_t k);
 
 #endif // __ARITHMEITC__
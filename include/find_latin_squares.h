@@ -8,12 +8,24 @@
 
 #define REFRESH_RATE (100)
 
+// the squares of side 7 do not fit in memory
+#define LATIN_SQUARE_TABLE_MAX_N (6)
+#define LATIN_SQUARE_LIST_MAX_COUNT (A000479[LATIN_SQUARE_TABLE_MAX_N])
+
 typedef uint8_t (*latin_square_callback)(latin_square *, void *);
 typedef uint8_t (*latin_square_array_callback)(latin_square *, uint64_t, void *);
 
 uint8_t iterate_over_all_square_callback(latin_square *P, latin_square_callback callback, void *data);
 uint8_t iterate_over_all_square_array_callback(latin_square *P, uint64_t len, latin_square_array_callback f, void *data);
 
+void latin_square_list_init(latin_square_list *list, uint32_t n);
+void latin_square_list_clear(latin_square_list *list);
+const latin_square_list *latin_square_table(uint32_t n);
+size_t latin_square_rank(const latin_square *P);
+void latin_square_unrank(latin_square *P, size_t rank);
+size_t number_of_latin_square_arrays(uint32_t r, uint32_t s);
+void latin_square_array_unrank(uint8_t *array, size_t idx, uint32_t r, uint32_t s);
+
 uint8_t action_on_all_latin_square_arrays(const char*const base_file_name, const char*const name, perf_counter* perf, action func, void* data);
 
 #endif // __FIND_LATIN_SQUARES__
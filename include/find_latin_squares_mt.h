@@ -23,13 +23,38 @@ typedef struct {
     uint64_t total_iterations;
     uint8_t stop_flag;
     uint32_t r, s; // sizes of the latin squares (and arrays)
+    size_t count;      // number of latin square arrays
+    size_t chunk_size; // number of arrays a thread claims at once
+    size_t next;       // first array not claimed yet, only ever incremented under mutex
+
+    size_t thread_count;
+    size_t* cursors;       // first array of the chunk each thread works on, SIZE_MAX if none
+    size_t* pending;       // chunks left unfinished by the run resumed, claimed before next
+    size_t pending_count;
+    const char* checkpoint_file; // where the scan saves its progress, NULL for none
+    uint64_t tag;                // identifies what the arrays are scanned for, see latin_square_checkpoint_tag
+    uint8_t interrupted;
 
     pthread_t display_thread;
 } mt_context;
 
+// arrays claimed at once by a thread of action_on_all_latin_square_arrays_mt
+#ifndef DEFAULT_LATIN_SQUARE_CHUNK
+  #define DEFAULT_LATIN_SQUARE_CHUNK (1024)
+#endif
+
+// name of the checkpoint of the scan, in the directory of the run, and seconds between two saves
+#define LATIN_SQUARE_CHECKPOINT_NAME "latin_squares.checkpoint"
+#ifndef LATIN_SQUARE_CHECKPOINT_PERIOD
+  #define LATIN_SQUARE_CHECKPOINT_PERIOD (60.0)
+#endif
+
 void mt_context_init(mt_context *ctx, uint32_t r, uint32_t s);
 void mt_context_free(mt_context *ctx);
 
-uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, const char*const name, size_t thread_count, perf_counter* perf, action func, void* init_data(void*), void clear_data(void *), void* data);
+uint64_t latin_square_checkpoint_tag(da_sets rels);
+uint8_t action_on_all_generated_latin_square_arrays_mt(uint32_t r, uint32_t s, size_t thread_count, size_t chunk_size, const char*const checkpoint_file, uint64_t tag, perf_counter* perf, action_batch func, void* init_data(void*), void clear_data(void *), void* data);
+size_t verify_all_latin_square_arrays(const char*const base_file_name, const char*const name);
+uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, const char*const name, size_t thread_count, size_t chunk_size, const char*const checkpoint_file, uint64_t tag, perf_counter* perf, action_batch func, void* init_data(void*), void clear_data(void *), void* data);
 
 #endif // __FIND_LATIN_SQUARES_MT__
@@ -25,9 +25,31 @@ typedef struct sets_search_data_s
 
 #define BATCH_SIZE 256
 
+// where -exhaustive saves its progress, in the directory of the run
+#define SETS_CHECKPOINT_NAME "sets.checkpoint"
+
+// where the collision method appends the sets it finds and saves its tables, in the directory of the run
+#define SETS_LOG_NAME "rels.log"
+#define SETS_SNAPSHOT_NAME "sets.tables"
+// where the prefilled tables of the collision method are kept with -prefill, one file per square,
+// outside of the run directories so that every run on the square finds it
+#define SETS_PREFILL_DIR "./"
+#define SETS_PREFILL_NAME "sets-%016" PRIx64 ".prefill"
+#ifndef SETS_SNAPSHOT_PERIOD
+  #define SETS_SNAPSHOT_PERIOD (600.0)
+#endif
+
+// number of partial sets the join method draws for each side before joining them
+#ifndef SETS_JOIN_BATCH
+  #define SETS_JOIN_BATCH (1 << 22)
+#endif
+
 void iterate_over_sets_callback(uint32_t r, uint32_t s, set_callback f, void *data);
 uint8_t find_sets_print_selection(uint8_t *selected, uint32_t n, void *_);
 uint8_t set_has_magic_sum(const uint8_t *selected, const pow_m_sqr M);
-void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, perf_counter* perf, set_callback f, void *data);
+void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, const char *log_file, const char *snapshot_file, const char *prefill_dir, perf_counter* perf, set_callback f, void *data);
+void find_sets_collision_method_mt(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, size_t thread_count, const char *log_file, const char *snapshot_file, const char *prefill_dir, perf_counter* perf, set_callback f, void *data);
+void find_sets_join_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, const char *log_file, perf_counter* perf, set_callback f, void *data);
+void find_sets_meet_in_the_middle(pow_m_sqr M, const uint32_t r, const uint32_t s, const char *checkpoint_file, uint8_t resume, perf_counter* perf, set_callback f, void *data);
 
 #endif // __FIND_SETS__
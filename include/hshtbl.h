@@ -0,0 +1,159 @@
+#ifndef __HSHTBL__
+#define __HSHTBL__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "types.h"
+
+#define HSHTBL_BASE_SIZE (32)
+#define HSHTBL_FULLNESS_RATIO (0.7)
+#define HSHTBL_MAX_FULLNESS_RATIO (0.70)
+#define HSHTBL_MAX_SIZE ((1<<25) - 1)
+
+typedef struct hshtbl_node_s
+{
+  uint64_t sum;
+  uint32_t item; // 1-based index of the entry in the arena, 0 marks an empty slot
+} hshtbl_node;
+
+typedef struct
+{
+  size_t count, capacity;
+  hshtbl_node *arr;
+  size_t max_capacity;   // the table stops growing once it reached this capacity
+  uint32_t width;        // number of rel_items per entry, fixed for the whole table
+  size_t arena_capacity; // number of entries the arena can hold before growing
+  rel_item *arena;       // count entries of width rel_items each, stored back to back
+  uint8_t read_only;     // arr and arena point into a mapped snapshot, see map_hshtbls
+} hshtbl;
+
+/*
+ * hshtbl format:
+ * arr is an array of capacity hshtbl_nodes
+ * a node is non-empty iff its item field is non-zero
+ * collisions are resolved by finding the next (mod capacity) empty slot in arr
+ * the items of the node are stored in the arena, at HSHTBL_NODE_ITEMS(table, node)
+ * the arena is only ever appended to, emptying the table just rewinds it
+ */
+
+#define HSHTBL_NODE_ITEMS(table, node) ((table)->arena + (size_t)((node).item - 1) * (table)->width)
+
+enum HSHTBL_STATUS
+{
+  HSHTBL_OK,
+  HSHTBL_FULL,
+  HSHTBL_STATUS_COUNT,
+};
+
+static inline uint32_t hash_func(uint64_t x)
+{
+  // from splitmix64
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x = x ^ (x >> 31);
+  return (uint32_t)x;
+}
+
+void init_hshtbl(hshtbl* h, const uint32_t width);
+hshtbl *init_hshtbls(const uint32_t n);
+void empty_hshtbl(hshtbl *table);
+void free_hshtbl(hshtbl *table);
+void free_hshtbls(hshtbl *table, const uint32_t n);
+uint8_t hshtbl_insert(hshtbl *table, const rel_item *items, const uint8_t *selected, const uint32_t count, const uint64_t sum, const uint64_t n);
+uint8_t hshtbl_insert_unique(hshtbl *table, const rel_item *items, const uint32_t count, const uint64_t sum);
+
+/*
+ * snapshot of hshtbls, for the tables which are only read once filled
+ * the file holds arr and arena as they are in memory, so it is used in place once mmaped:
+ * the mapped tables are read only and their pages are shared by every process mapping the same file
+ * key tells apart the contents, a snapshot is only mapped with the key it was saved with
+ */
+
+typedef struct
+{
+  void *base;
+  size_t size;
+} hshtbls_mapping;
+
+uint8_t save_hshtbls(const char *file, const hshtbl *tables, const uint32_t count, const uint64_t key);
+uint8_t map_hshtbls(const char *file, hshtbl *tables, const uint32_t count, const uint64_t key, hshtbls_mapping *mapping);
+void unmap_hshtbls(hshtbls_mapping *mapping);
+
+/*
+ * lock-free version of hshtbl, for the partial sets shared by multiple threads
+ *
+ * the table never grows: its capacity is fixed at init and inserts are refused with HSHTBL_FULL once
+ * max_count entries are stored, in place of the HSHTBL_MAX_SIZE cutoff of hshtbl
+ * the pages of the arrays are only touched when used, so a large capacity is cheap until it is filled,
+ * and emptying the table hands the pages of arr back to the system instead of clearing them
+ *
+ * a slot goes EMPTY -> BUSY (claimed by a CAS) -> READY (sum and items written), it is never modified again
+ * until the table is emptied, which must not happen while other threads use it
+ * readers skip BUSY slots: a partial set being inserted might be missed by a concurrent lookup
+ */
+
+// capacity of the biggest tables, the same as the HSHTBL_MAX_SIZE cutoff of hshtbl
+#define LF_HSHTBL_CAPACITY (1<<25)
+
+enum LF_HSHTBL_SLOT_STATE
+{
+  LF_HSHTBL_EMPTY,
+  LF_HSHTBL_BUSY,
+  LF_HSHTBL_READY,
+};
+
+typedef struct lf_hshtbl_node_s
+{
+  uint64_t sum;
+  uint32_t state;
+} lf_hshtbl_node;
+
+typedef struct
+{
+  size_t count;     // only ever incremented atomically, might go past max_count by the number of inserting threads
+  size_t capacity;  // power of 2
+  size_t max_count;
+  uint32_t width;   // number of rel_items per entry
+  lf_hshtbl_node *arr;
+  rel_item *items;  // capacity entries of width rel_items, the entry of slot h is at items + h * width
+} lf_hshtbl;
+
+#define LF_HSHTBL_SLOT_ITEMS(table, h) ((table)->items + (size_t)(h) * (table)->width)
+
+void init_lf_hshtbl(lf_hshtbl *table, const uint32_t width, const size_t capacity);
+void empty_lf_hshtbl(lf_hshtbl *table);
+void free_lf_hshtbl(lf_hshtbl *table);
+uint8_t lf_hshtbl_insert(lf_hshtbl *table, const rel_item *items, const uint8_t *selected, const uint32_t count, const uint64_t sum, const uint64_t n);
+int64_t lf_hshtbl_find_next(const lf_hshtbl *table, const uint64_t sum, int64_t h);
+size_t lf_hshtbl_count(const lf_hshtbl *table);
+
+/*
+ * dedup table of complete sets
+ * the sets are appended to a log in the order they are found, n rel_items each,
+ * the table itself only holds a fingerprint of the set and its (1-based) index in the log
+ */
+
+typedef struct found_set_node_s
+{
+  uint64_t fingerprint;
+  uint32_t index; // 1-based index of the set in the log, 0 marks an empty slot
+} found_set_node;
+
+typedef struct
+{
+  size_t count, capacity; // capacity is a power of 2
+  found_set_node *arr;
+  uint32_t n;             // number of rel_items per set
+  size_t log_capacity;
+  rel_item *log;          // count sets, in the order they were found
+} found_set_table;
+
+#define FOUND_SET_ITEMS(table, k) ((table)->log + (size_t)(k) * (table)->n)
+
+uint64_t set_fingerprint(const rel_item *items, const uint32_t n);
+void init_found_set_table(found_set_table *table, const uint32_t n, const size_t expected);
+void free_found_set_table(found_set_table *table);
+uint8_t found_set_table_insert(found_set_table *table, const rel_item *items);
+
+#endif // __HSHTBL__
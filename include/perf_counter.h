@@ -18,6 +18,7 @@ void printf_perf(perf_counter* perf, const char *const name);
 void perf_counter_init  (perf_counter* perf, const double lspeed_windows);
 void perf_counter_clear (perf_counter* perf);
 void perf_counter_tick  (perf_counter *perf);
+void perf_counter_add   (perf_counter *perf, uint64_t count);
 void perf_counter_update(perf_counter* perf);
 
 #endif // __PERF_COUNTER__
@@ -150,4 +151,10 @@ void perf_counter_tick(perf_counter *perf)
   ++perf->lcounter;
 }
 
+void perf_counter_add(perf_counter *perf, uint64_t count)
+{
+  perf->counter += count;
+  perf->lcounter += count;
+}
+
 #endif
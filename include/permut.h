@@ -7,6 +7,11 @@
 
 void position_after_latin_square_permutation(uint32_t *ret_row, uint32_t *ret_col, uint32_t row, uint32_t col, latin_square *P, latin_square *Q, const uint32_t r, const uint32_t s);
 uint8_t fall_on_different_line_after_latin_squares(uint8_t* rows, uint8_t* cols, rel_item *poses, latin_square *P, latin_square *Q, const uint32_t r, const uint32_t s);
+void latin_squares_inv_compute(latin_squares_inv *inv, const latin_square *P, const latin_square *Q, const uint32_t r, const uint32_t s);
+void latin_squares_inv_compute_from_array(latin_squares_inv *inv, const uint8_t *array, const uint32_t r, const uint32_t s);
+void latin_squares_inv_from_maps(latin_squares_inv *inv, const uint8_t *maps, const uint32_t r, const uint32_t s);
+void position_after_latin_square_permutation_inv(uint32_t *ret_row, uint32_t *ret_col, rel_item row, rel_item col, const latin_squares_inv *inv);
+uint8_t fall_on_different_line_after_latin_squares_inv(uint8_t* rows, uint8_t* cols, rel_item *poses, const latin_squares_inv *inv);
 uint8_t rels_are_diagonizable(rel_item* rel1, rel_item* rel2, rel_item* rel1_inv, rel_item* sigma, size_t n);
 void permute_into_pow_m_sqr(pow_m_sqr *M, rel_item *diag1, rel_item *diag2);
 uint8_t rels_are_disjoint(rel_item *rel1, rel_item *rel2, const size_t n);
@@ -14,5 +19,39 @@ uint8_t rels_are_compatible(rel_item *rel1, rel_item *rel2, const size_t n);
 void printf_rel(rel_item *rel, const size_t n);
 void pos_rel_to_x_y_rel(x_y_rel ret, pos_rel op, const size_t n);
 void x_y_rel_after_latin_squares(x_y_rel ret, pos_rel op, latin_square* P, latin_square* Q, const size_t r, const size_t s);
+void x_y_rel_after_latin_squares_inv(x_y_rel ret, pos_rel op, const latin_squares_inv *inv);
+uint8_t x_y_rel_after_latin_squares_inv_checked(x_y_rel ret, uint8_t* rows, uint8_t* cols, pos_rel op, const latin_squares_inv *inv);
+void latin_square_array_canonicalize(uint8_t *array, rel_item *row_relabel, rel_item *col_relabel, const uint32_t r, const uint32_t s);
+
+/*
+ * x_y_rels of n <= 16 entries packed one rel_item per byte into two words, entry k in the byte k % 8 of word k / 8
+ * two of them share a cell iff a byte of their xor is zero, for the n first bytes only
+ */
+#define PACKED_X_Y_REL_WORDS (2)
+#define BYTES_ONES  (0x0101010101010101ULL)
+#define BYTES_HIGHS (0x8080808080808080ULL)
+
+static inline void pack_x_y_rel(uint64_t *words, const x_y_rel rel, const uint32_t n)
+{
+  words[0] = 0;
+  words[1] = 0;
+  for (uint32_t k = 0; k < n; ++k)
+    words[k / 8] |= (uint64_t)rel[k] << (8 * (k % 8));
+  return;
+}
+
+static inline uint8_t packed_x_y_rels_are_disjoint(const uint64_t *a, const uint64_t *b, const uint32_t n)
+{
+  uint64_t hits = 0;
+  for (uint32_t w = 0; w < PACKED_X_Y_REL_WORDS; ++w)
+  {
+    const uint64_t x = a[w] ^ b[w];
+    // the high bit of every zero byte is set, a borrow can only flag a byte above a zero one
+    // the bytes past n are zero in both words, they are above every entry: mask them out
+    const uint64_t lanes = n >= 8 * (w + 1) ? UINT64_MAX : n <= 8 * w ? 0 : (1ULL << (8 * (n - 8 * w))) - 1;
+    hits |= (x - BYTES_ONES) & ~x & BYTES_HIGHS & lanes;
+  }
+  return hits == 0;
+}
 
 #endif // __PERMUT__
@@ -10,6 +10,9 @@
 // will evalutate `M` multiple times !!
 #define M_SQR_GET_AS_MAT(M, i, j) ((M).arr[((M).rows[(i)]) * ((M).n) + ((M).cols[(j)])])
 #define M_SQR_GET_AS_VEC(M, idx) ((M).arr[(idx)])
+// the d-th power of the entry, read from the cache: only valid if it is in sync with arr
+#define M_SQR_GET_POW_AS_MAT(M, i, j) ((M).pows[((M).rows[(i)]) * ((M).n) + ((M).cols[(j)])])
+#define M_SQR_GET_POW_AS_VEC(M, idx) ((M).pows[(idx)])
 
 #define GET_AS_MAT(arr, i, j, width) ((arr)[(i) * (width) + (j)])
 
@@ -18,6 +21,7 @@
 // init and conversion
 int pow_m_sqr_init(pow_m_sqr *M, uint64_t n, uint64_t d);
 void pow_m_sqr_clear(pow_m_sqr *M);
+void pow_m_sqr_update_pows(pow_m_sqr M);
 void highlighted_square_init(highlighted_square *ret, const uint32_t n, const uint32_t d);
 void highlighted_square_clear(highlighted_square *ret);
 void highlighted_square_from_pow_m_sqr(highlighted_square *ret, const pow_m_sqr *M, const rel_item *rel1, const rel_item *rel2);
@@ -45,6 +49,7 @@ int search_pow_m_sqr(pow_m_sqr base, uint64_t X, uint64_t progress, uint8_t *hea
 void pow_semi_m_sqr_from_taxicab(pow_m_sqr M, taxicab a, taxicab b, latin_square *P, latin_square *Q);
 void semi_to_full_naive(perf_counter* perf, pow_m_sqr M);
 void semi_to_full_simultanious_perm(perf_counter* perf, pow_m_sqr M);
+void semi_to_full_meet_in_the_middle(perf_counter* perf, pow_m_sqr M);
 void generate_siamese(pow_m_sqr M);
 int8_t parity_of_sets(uint32_t *rel1, uint32_t *rel2, const uint64_t n);
 
@@ -0,0 +1,71 @@
+#ifndef __RNG__
+#define __RNG__
+
+#include <stdint.h>
+
+/*
+ * xoshiro256** by David Blackman and Sebastiano Vigna
+ * every engine drawing random numbers owns an rng and passes it down explicitly,
+ * threads get independent streams from rng_split_global
+ */
+typedef struct rng_s
+{
+  uint64_t s[4];
+} rng;
+
+void rng_seed(rng *g, uint64_t seed);
+void rng_jump(rng *g);
+
+/*
+ * the global stream is seeded once (from the -seed flag) and only used to hand out independent streams:
+ * each call returns a copy of the global stream and jumps it 2^128 draws ahead
+ * thread safe, the streams are deterministic as long as they are split in the same order
+ */
+void rng_seed_global(uint64_t seed);
+rng rng_split_global(void);
+
+static inline uint64_t rng_rotl(const uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng *g)
+{
+  uint64_t *s = g->s;
+  const uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+
+  s[2] ^= t;
+
+  s[3] = rng_rotl(s[3], 45);
+
+  return result;
+}
+
+/*
+ * uniform in [0, range), range must be non-zero
+ * Lemire's multiply-shift: the division computing the rejection threshold only happens for the rare
+ * draws which might be biased
+ */
+static inline uint32_t rng_bounded(rng *g, const uint32_t range)
+{
+  uint64_t m = (rng_next(g) >> 32) * (uint64_t)range;
+  uint32_t l = (uint32_t)m;
+  if (l < range)
+  {
+    const uint32_t t = -range % range;
+    while (l < t)
+    {
+      m = (rng_next(g) >> 32) * (uint64_t)range;
+      l = (uint32_t)m;
+    }
+  }
+  return m >> 32;
+}
+
+#endif // __RNG__
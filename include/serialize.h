@@ -20,6 +20,7 @@ void load_pow_m_sqr(const char* const base_file_name, pow_m_sqr* M, const char*
 void latex_pow_m_sqr(const char* const base_file_name, pow_m_sqr M, const char* const lname, const size_t r, const size_t s);
 
 void load_taxicabs(const char* const base_file_name, taxicab* a, const char* const a_name, taxicab* b, const char* const b_name);
+void load_rels(const char* const base_file_name, da_sets* rels, const char* const rels_name);
 void fread_latin_square_array(FILE* f, latin_square* P);
 void flatex_taxicab(FILE* f, taxicab a);
 void latex_taxicab(const char* const base_file_name, taxicab a, const char* const lname);
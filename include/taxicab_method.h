@@ -8,6 +8,6 @@
   #define REQUIERED_SETS (1UL<<5)
 #endif
 
-void search_pow_m_sqr_from_taxicabs(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets);
+void search_pow_m_sqr_from_taxicabs(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, uint8_t exhaustive, uint8_t join, uint8_t snapshot, uint8_t prefill);
 
 #endif // __TAXICAB_METHOD__
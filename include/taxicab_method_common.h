@@ -22,13 +22,18 @@ typedef struct
   latin_square *P, *Q;
   pow_m_sqr *M;
   uint32_t r, s;
-  da_sets rels, mark;
+  da_sets rels;
   perf_counter* perf;
-  x_y_rel rel1, rel2, inv, sigma;
+  x_y_rel mapped;        // rels.count x_y_rels of n rel_items, the rels mapped through the current array
+  uint32_t* mapped_rels; // index in rels of each of them
+  uint64_t* packed;      // each of them packed by pack_x_y_rel, PACKED_X_Y_REL_WORDS words apiece
+  x_y_rel inv, sigma;
   uint8_t* rows, *cols;
+  latin_squares_inv ls_inv; // of the array currently checked
   uint16_t refresh_frame;
 
   FILE* f;
+  FILE* f_inv; // optional, where to write the latin_squares_inv of each array
 } iterate_over_latin_squares_array_pack;
 
 uint8_t search_pow_m_sqr_from_taxicab_iterate_over_sets_callback(uint8_t *selected, uint32_t n, void *data);
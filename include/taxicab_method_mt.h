@@ -12,6 +12,6 @@
   #define DEFAULT_MAX_THREADS 4
 #endif
 
-void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, size_t thread_count);
+void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, size_t thread_count, size_t chunk_size, uint8_t exhaustive, uint8_t join, uint8_t stream, uint8_t resume, uint8_t snapshot, uint8_t prefill);
 
 #endif // __TAXICAB_METHOD_MT__
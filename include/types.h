@@ -9,6 +9,7 @@ typedef struct pow_m_sqr_s
   uint32_t n, d;
   uint32_t *rows, *cols;
   uint64_t *arr;
+  uint64_t *pows; // arr[idx]^d at pows[idx], see pow_m_sqr_update_pows
 } pow_m_sqr;
 
 typedef struct highlighted_square_s
@@ -28,6 +29,31 @@ typedef struct
   uint8_t *arr;
 } latin_square;
 
+/*
+ * every latin square of side n with the first row 0, 1, ..., n - 1, in the order of iterate_over_all_square_callback
+ * the k-th one is at arr + k * n * n
+ */
+typedef struct
+{
+  uint32_t n;
+  size_t count;
+  uint8_t *arr;
+} latin_square_list;
+
+/*
+ * where the entries of the standart latin squares end up in an array of latin squares, see permut.c
+ * P_map[(j * s + i) * s + v] = v' such that P[j]_{i, v'} = [P_standart]_{i, v}
+ * Q_map[(i * r + j) * r + u] = u' such that Q[i]_{j, u'} = [Q_standart]_{j, u}
+ * P_map holds r * s * s entries and Q_map s * r * r, Q_map right after P_map: the same size as the array itself
+ * the maps either point to tables, or to a record of the .latin_square_inv file
+ */
+typedef struct
+{
+  uint32_t r, s;
+  const uint8_t *P_map, *Q_map;
+  uint8_t tables[2 * 16 * 16]; // where latin_squares_inv_compute stores the maps
+} latin_squares_inv;
+
 /*
  * represents a (r, s, d)-taxicab
  * ie   a_{1, 1}^d + a_{1, 2}^d + ... + a_{1, s}^d
@@ -74,7 +100,16 @@ typedef struct da_sets_s
   uint32_t n; // size of each set
 } da_sets;
 
-typedef uint8_t (*action)(latin_square*, uint32_t, latin_square*, uint32_t, void*);
+/*
+ * the latin_squares_inv of the array is given if it was precomputed, NULL otherwise
+ */
+typedef uint8_t (*action)(latin_square*, uint32_t, latin_square*, uint32_t, const latin_squares_inv*, void*);
+
+/*
+ * count consecutive arrays as laid out in the .latin_square file, then r and s
+ * the maps of their latin_squares_inv are given laid out the same way if they were precomputed, NULL otherwise
+ */
+typedef uint8_t (*action_batch)(const uint8_t*, const uint8_t*, size_t, uint32_t, uint32_t, void*);
 
 extern const uint64_t A000479[];
 
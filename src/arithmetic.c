@@ -24,3 +24,17 @@ uint64_t gcd(uint64_t a, uint64_t b)
   return a;
 }
 
+/*
+ * return n choose k, the intermediate products must fit in 64 bits
+ */
+uint64_t binomial(uint64_t n, uint64_t k)
+{
+  if (k > n)
+    return 0;
+
+  uint64_t acc = 1;
+  for (uint64_t i = 1; i <= k; ++i)
+    acc = acc * (n - k + i) / i;
+  return acc;
+}
+
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include <ncurses.h>
 #include "nob.h"
@@ -10,19 +12,27 @@
 #include "pow_m_sqr.h"
 #include "serialize.h"
 
+/*
+ * the side is bounded by the width of the masks
+ */
+#define LATIN_SQUARE_ENGINE_MAX_N (16)
+
+/*
+ * state of the backtracking over the cells of one latin square, no allocation needed
+ * bit num of usedInRow[row] (resp. usedInCol[col]) is set when num is already in the row (resp. column)
+ * candidates[idx] holds the values left to try in the cell idx, it acts as the explicit stack of the search
+ */
 typedef struct
 {
-  uint64_t n;
-  uint8_t **usedInRow;
-  uint8_t **usedInCol;
-  // bool inited;
+  uint32_t n;
+  uint16_t usedInRow[LATIN_SQUARE_ENGINE_MAX_N];
+  uint16_t usedInCol[LATIN_SQUARE_ENGINE_MAX_N];
+  uint16_t candidates[LATIN_SQUARE_ENGINE_MAX_N * LATIN_SQUARE_ENGINE_MAX_N];
 } state;
 
 #define LATIN_SQUARE_UNSET UINT8_MAX
 
-void init_arrays(state *s);
-void free_arrays(state *s);
-uint8_t iterate_over_all_square_callback_inside(state *s, latin_square *P, uint64_t row, uint64_t col, latin_square_callback callback, void *data);
+static uint8_t iterate_over_all_square_callback_inside(state *s, latin_square *P, latin_square_callback callback, void *data);
 
 // state s = {.inited = false};
 
@@ -38,75 +48,118 @@ uint8_t iterate_over_all_square_callback_inside(state *s, latin_square *P, uint6
  */
 uint8_t iterate_over_all_square_callback(latin_square *P, latin_square_callback callback, void *data)
 {
-  state s = {.n = P->n};
-  init_arrays(&s);
-  for (uint32_t idx = 0; idx < P->n * P->n; ++idx)
-    M_SQR_GET_AS_VEC(*P, idx) = LATIN_SQUARE_UNSET;
+  state s;
+  return iterate_over_all_square_callback_inside(&s, P, callback, data);
+}
 
-  // Fix first row: {0, 1, 2, ..., n - 1}
-  for (uint64_t col = 0; col < P->n; col++)
+// Iterative backtracking over the cells in row-major order, the values are tried in increasing order
+static uint8_t iterate_over_all_square_callback_inside(state *s, latin_square *P, latin_square_callback callback, void *data)
+{
+  const uint32_t n = P->n;
+  if (n > LATIN_SQUARE_ENGINE_MAX_N)
   {
-    GET_AS_MAT(P->arr, 0, col, P->n) = col;
-    s.usedInRow[0][col] = 1;
-    s.usedInCol[col][col] = 1;
+    fprintf(stderr, "[ERROR] Can not enumerate latin squares of side %u > %u\n", n, LATIN_SQUARE_ENGINE_MAX_N);
+    exit(1);
   }
 
-  // start from second row, first column
-  uint8_t ret = iterate_over_all_square_callback_inside(&s, P, 1, 0, callback, data);
-  free_arrays(&s);
-  return ret;
-}
+  const uint32_t size = n * n;
+  const uint16_t full = (uint16_t)((1u << n) - 1);
 
-// Recursive backtracking function to fill the square
-uint8_t iterate_over_all_square_callback_inside(state *s, latin_square *P, uint64_t row, uint64_t col, latin_square_callback callback, void *data)
-{
-  // normally : 0 <= row < n but here we overflowed ie the square is full
-  if (row == P->n)
-    return (*callback)(P, data);
+  s->n = n;
+  memset(s->usedInRow, 0, sizeof(s->usedInRow));
+  memset(s->usedInCol, 0, sizeof(s->usedInCol));
+  for (uint32_t idx = 0; idx < size; ++idx)
+    M_SQR_GET_AS_VEC(*P, idx) = LATIN_SQUARE_UNSET;
 
-  if (GET_AS_MAT(P->arr, row, col, P->n) != LATIN_SQUARE_UNSET)
+  // Fix first row: {0, 1, 2, ..., n - 1}
+  for (uint32_t col = 0; col < n; col++)
   {
-    // Move to next cell
-    if (col == P->n - 1)
-      return iterate_over_all_square_callback_inside(s, P, row + 1, 0, callback, data);
-    else
-      return iterate_over_all_square_callback_inside(s, P, row, col + 1, callback, data);
+    GET_AS_MAT(P->arr, 0, col, n) = col;
+    s->usedInRow[0] |= 1u << col;
+    s->usedInCol[col] = 1u << col;
   }
 
-  for (uint64_t num = 0; num < P->n; num++)
+  // normally : 0 <= row < n but here the first row already fills the square
+  if (size == n)
+    return (*callback)(P, data);
+
+  // start from second row, first column
+  uint32_t idx = n, row = 1, col = 0;
+  s->candidates[idx] = full & ~(s->usedInRow[row] | s->usedInCol[col]);
+
+  for (;;)
   {
-    if (!(s->usedInRow[row][num]) && !(s->usedInCol[col][num]))
+    if (s->candidates[idx] == 0)
     {
-      GET_AS_MAT(P->arr, row, col, P->n) = num;
-      s->usedInRow[row][num] = 1;
-      s->usedInCol[col][num] = 1;
-
-      // Move to next cell
-      uint8_t cont = (col == P->n - 1) ? iterate_over_all_square_callback_inside(s, P, row + 1, 0, callback, data)
-                                       : iterate_over_all_square_callback_inside(s, P, row, col + 1, callback, data);
+      if (idx == n)
+        return 1;
 
       // Backtrack
-      GET_AS_MAT(P->arr, row, col, P->n) = LATIN_SQUARE_UNSET;
-      s->usedInRow[row][num] = 0;
-      s->usedInCol[col][num] = 0;
+      --idx;
+      if (col == 0)
+      {
+        col = n - 1;
+        --row;
+      }
+      else
+        --col;
+
+      const uint8_t num = P->arr[idx];
+      P->arr[idx] = LATIN_SQUARE_UNSET;
+      s->usedInRow[row] ^= 1u << num;
+      s->usedInCol[col] ^= 1u << num;
+      continue;
+    }
+
+    const uint8_t num = __builtin_ctz(s->candidates[idx]);
+    s->candidates[idx] &= s->candidates[idx] - 1;
+
+    if (idx == size - 1)
+    {
+      // no cell comes after the last one, its value does not need to be recorded in the masks
+      P->arr[idx] = num;
+      const uint8_t cont = (*callback)(P, data);
+      P->arr[idx] = LATIN_SQUARE_UNSET;
 
       if (!cont)
+      {
+        for (uint32_t i = n; i < idx; ++i)
+          P->arr[i] = LATIN_SQUARE_UNSET;
         return 0;
+      }
+      continue;
     }
-  }
 
-  return 1;
+    P->arr[idx] = num;
+    s->usedInRow[row] |= 1u << num;
+    s->usedInCol[col] |= 1u << num;
+
+    // Move to next cell
+    ++idx;
+    if (col == n - 1)
+    {
+      col = 0;
+      ++row;
+    }
+    else
+      ++col;
+    s->candidates[idx] = full & ~(s->usedInRow[row] | s->usedInCol[col]);
+  }
 }
 
+/*
+ * one state per square of the array, allocated once for the whole enumeration
+ */
 typedef struct
 {
   latin_square *base;
   uint64_t len;
+  state *states;
   latin_square_array_callback f;
   void *data;
 } square_array_pack;
 
-uint8_t iterate_over_all_square_array_callback_inside(latin_square *P, void *data)
+static uint8_t iterate_over_all_square_array_callback_inside(latin_square *P, void *data)
 {
   square_array_pack *pack = (square_array_pack *)data;
   latin_square *base = pack->base;
@@ -118,41 +171,108 @@ uint8_t iterate_over_all_square_array_callback_inside(latin_square *P, void *dat
     return (pack->f)(base, pack->len, pack->data);
 
   // we do not need to handle stop here as the external function, which is not recursive, will just return once the search on the first element ended
-  return iterate_over_all_square_callback(P + 1, iterate_over_all_square_array_callback_inside, data);
+  return iterate_over_all_square_callback_inside(pack->states + (P - base) + 1, P + 1, iterate_over_all_square_array_callback_inside, data);
 }
 
 uint8_t iterate_over_all_square_array_callback(latin_square *P, uint64_t len, latin_square_array_callback f, void *data)
 {
   square_array_pack pack = {.base = P, .len = len, .f = f, .data = data};
-  return iterate_over_all_square_callback(P, iterate_over_all_square_array_callback_inside, &pack);
+  pack.states = malloc(len * sizeof(*pack.states));
+  if (pack.states == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  uint8_t ret = iterate_over_all_square_callback_inside(pack.states, P, iterate_over_all_square_array_callback_inside, &pack);
+  free(pack.states);
+  return ret;
 }
 
-void init_arrays(state *s)
+static uint8_t append_to_latin_square_list(latin_square *P, void *data)
 {
-  // Allocate usedInRow
-  s->usedInRow = malloc(s->n * sizeof(bool *));
-  for (uint64_t i = 0; i < s->n; i++)
+  latin_square_list *list = data;
+  memcpy(list->arr + list->count * list->n * list->n, P->arr, list->n * list->n * sizeof(*P->arr));
+  ++(list->count);
+  return 1;
+}
+
+/*
+ * fills list with every latin square of side n, see latin_square_list
+ */
+void latin_square_list_init(latin_square_list *list, uint32_t n)
+{
+  if (A000479[n] > LATIN_SQUARE_LIST_MAX_COUNT)
   {
-    s->usedInRow[i] = calloc(s->n, sizeof(bool));
+    fprintf(stderr, "[ERROR] There are %"PRIu64" latin squares of side %u, too many to hold in memory\n", A000479[n], n);
+    exit(1);
   }
 
-  // Allocate usedInCol
-  s->usedInCol = malloc(s->n * sizeof(bool *));
-  for (uint64_t i = 0; i < s->n; i++)
+  list->n = n;
+  list->count = 0;
+  list->arr = malloc(A000479[n] * n * n * sizeof(*list->arr));
+  if (list->arr == NULL)
   {
-    s->usedInCol[i] = calloc(s->n, sizeof(bool));
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
   }
+
+  latin_square P;
+  latin_square_init(&P, n);
+  iterate_over_all_square_callback(&P, append_to_latin_square_list, list);
+  latin_square_clear(&P);
+
+  return;
+}
+
+void latin_square_list_clear(latin_square_list *list)
+{
+  free(list->arr);
+  list->arr = NULL;
+  list->count = 0;
+  return;
+}
+
+/*
+ * number of arrays of r squares of side s and s squares of side r, 0 if it does not fit in a size_t
+ */
+size_t number_of_latin_square_arrays(uint32_t r, uint32_t s)
+{
+  const latin_square_list *Ps = latin_square_table(s);
+  const latin_square_list *Qs = latin_square_table(r);
+
+  size_t count = 1;
+  for (uint32_t j = 0; j < r; ++j)
+    if (__builtin_mul_overflow(count, Ps->count, &count))
+      return 0;
+  for (uint32_t i = 0; i < s; ++i)
+    if (__builtin_mul_overflow(count, Qs->count, &count))
+      return 0;
+  return count;
 }
 
-void free_arrays(state *s)
+/*
+ * writes the idx-th array into array, laid out as in the .latin_square file
+ * the squares are the ones of latin_square_table, the index of each one is its latin_square_rank
+ * the arrays come in the order of save_all_latin_square_arrays: P[0] is the slowest to change, Q[s - 1] the fastest
+ */
+void latin_square_array_unrank(uint8_t *array, size_t idx, uint32_t r, uint32_t s)
 {
-  for (uint64_t i = 0; i < s->n; i++)
+  const latin_square_list *Ps = latin_square_table(s);
+  const latin_square_list *Qs = latin_square_table(r);
+
+  for (uint32_t i = s; i-- > 0;)
+  {
+    memcpy(array + r * s*s + i * r*r, Qs->arr + (idx % Qs->count) * r*r, r*r);
+    idx /= Qs->count;
+  }
+  for (uint32_t j = r; j-- > 0;)
   {
-    free(s->usedInRow[i]);
-    free(s->usedInCol[i]);
+    memcpy(array + j * s*s, Ps->arr + (idx % Ps->count) * s*s, s*s);
+    idx /= Ps->count;
   }
-  free(s->usedInRow);
-  free(s->usedInCol);
+
+  return;
 }
 
 /*
@@ -194,7 +314,7 @@ uint8_t action_on_all_latin_square_arrays(const char*const base_file_name, const
     for (uint32_t j = 0; j < s; ++j)
       fread_latin_square_array(f, Q + j);
 
-    if (!(*func)(P, r, Q, s, data))
+    if (!(*func)(P, r, Q, s, NULL, data))
     {
       ret = 1;
       break;
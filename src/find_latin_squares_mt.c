@@ -7,6 +7,7 @@
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <signal.h>
 #include <sys/mman.h>
 
 #include "latin_squares.h"
@@ -14,6 +15,7 @@
 #include "find_latin_squares.h"
 #include "perf_counter.h"
 #include "types.h"
+#include "permut.h"
 
 #include "nob.h"
 
@@ -30,6 +32,16 @@ void mt_context_init(mt_context *ctx, uint32_t r, uint32_t s)
   ctx->stop_flag        = 0;
   ctx->r                = r;
   ctx->s                = s;
+  ctx->count            = 0;
+  ctx->chunk_size       = DEFAULT_LATIN_SQUARE_CHUNK;
+  ctx->next             = 0;
+  ctx->thread_count     = 0;
+  ctx->cursors          = NULL;
+  ctx->pending          = NULL;
+  ctx->pending_count    = 0;
+  ctx->checkpoint_file  = NULL;
+  ctx->tag              = 0;
+  ctx->interrupted      = 0;
 
   return;
 }
@@ -37,18 +49,189 @@ void mt_context_init(mt_context *ctx, uint32_t r, uint32_t s)
 void mt_context_free(mt_context *ctx)
 {
   pthread_mutex_destroy(&ctx->mutex);
+  free(ctx->cursors);
+  free(ctx->pending);
+}
+
+/*
+ * FNV-1a of the rels, a checkpoint is only resumed with the rels it was saved with
+ */
+uint64_t latin_square_checkpoint_tag(da_sets rels)
+{
+  uint64_t tag = 14695981039346656037ULL;
+  tag = (tag ^ rels.n) * 1099511628211ULL;
+  tag = (tag ^ rels.count) * 1099511628211ULL;
+  for (size_t k = 0; k < rels.count; ++k)
+    for (uint32_t i = 0; i < rels.n; ++i)
+      tag = (tag ^ rels.items[k][i]) * 1099511628211ULL;
+
+  return tag;
+}
+
+/*
+ * Format:
+ * [   r   ][   s   ][ count ][ chunk_size ][  tag   ][ thread_count ][ next ][ chunk_count ][     chunks     ]
+ * uint32_t uint32_t  size_t   size_t        uint64_t  size_t          size_t  size_t         chunk_count size_t
+ * chunks holds the first array of every chunk claimed and not finished: every other array below next was scanned
+ */
+static void save_latin_square_checkpoint(mt_context *ctx)
+{
+  if (ctx->checkpoint_file == NULL)
+    return;
+
+  pthread_mutex_lock(&ctx->mutex);
+  const size_t next = ctx->next < ctx->count ? ctx->next : ctx->count;
+  size_t chunk_count = 0;
+  size_t *chunks = malloc((ctx->pending_count + ctx->thread_count) * sizeof(size_t));
+  if (chunks == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+  for (size_t k = 0; k < ctx->pending_count; ++k)
+    chunks[chunk_count++] = ctx->pending[k];
+  for (size_t thread_idx = 0; thread_idx < ctx->thread_count; ++thread_idx)
+    if (ctx->cursors[thread_idx] != SIZE_MAX)
+      chunks[chunk_count++] = ctx->cursors[thread_idx];
+  pthread_mutex_unlock(&ctx->mutex);
+
+  // write then rename, so that an interrupted write never loses the previous checkpoint
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", ctx->checkpoint_file);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "[ERROR] Could not open file %s: %s\n", tmp, strerror(errno));
+    free(chunks);
+    return;
+  }
+  fwrite(&ctx->r,            sizeof(ctx->r),            1, f);
+  fwrite(&ctx->s,            sizeof(ctx->s),            1, f);
+  fwrite(&ctx->count,        sizeof(ctx->count),        1, f);
+  fwrite(&ctx->chunk_size,   sizeof(ctx->chunk_size),   1, f);
+  fwrite(&ctx->tag,          sizeof(ctx->tag),          1, f);
+  fwrite(&ctx->thread_count, sizeof(ctx->thread_count), 1, f);
+  fwrite(&next,              sizeof(next),              1, f);
+  fwrite(&chunk_count,       sizeof(chunk_count),       1, f);
+  fwrite(chunks,             sizeof(*chunks), chunk_count, f);
+  fclose(f);
+  free(chunks);
+
+  if (rename(tmp, ctx->checkpoint_file) != 0)
+    fprintf(stderr, "[ERROR] Could not rename %s: %s\n", tmp, strerror(errno));
+
+  return;
+}
+
+/*
+ * sets next, chunk_size and the pending chunks from the checkpoint, leaves them untouched if there is no matching checkpoint
+ * the chunks left over by the threads of the previous scan are shared among the threads of this one, whatever their number
+ */
+static void load_latin_square_checkpoint(mt_context *ctx)
+{
+  if (ctx->checkpoint_file == NULL)
+    return;
+
+  FILE *f = fopen(ctx->checkpoint_file, "rb");
+  if (f == NULL)
+    return;
+
+  uint32_t r = 0, s = 0;
+  uint64_t tag = 0;
+  size_t count = 0, chunk_size = 0, thread_count = 0, next = 0, chunk_count = 0;
+  uint8_t ok = fread(&r,            sizeof(r),            1, f) == 1
+            && fread(&s,            sizeof(s),            1, f) == 1
+            && fread(&count,        sizeof(count),        1, f) == 1
+            && fread(&chunk_size,   sizeof(chunk_size),   1, f) == 1
+            && fread(&tag,          sizeof(tag),          1, f) == 1
+            && fread(&thread_count, sizeof(thread_count), 1, f) == 1
+            && fread(&next,         sizeof(next),         1, f) == 1
+            && fread(&chunk_count,  sizeof(chunk_count),  1, f) == 1;
+  ok = ok && r == ctx->r && s == ctx->s && count == ctx->count && tag == ctx->tag && chunk_size > 0 && next <= count;
+
+  size_t *chunks = NULL;
+  if (ok)
+  {
+    chunks = malloc(chunk_count * sizeof(size_t));
+    if (chunks == NULL && chunk_count > 0)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+    ok = fread(chunks, sizeof(*chunks), chunk_count, f) == chunk_count;
+  }
+  fclose(f);
+
+  if (!ok)
+  {
+    fprintf(stderr, "[WARNING] Ignoring checkpoint %s: it does not belong to this scan\n", ctx->checkpoint_file);
+    free(chunks);
+    return;
+  }
+
+  ctx->next          = next;
+  ctx->chunk_size    = chunk_size;
+  ctx->pending       = chunks;
+  ctx->pending_count = chunk_count;
+
+#ifndef __NO_GUI__
+  printw("Resuming the scan at %zu / %zu with %zu chunks left over by %zu threads\n", next, count, chunk_count, thread_count);
+#else
+  printf("Resuming the scan at %zu / %zu with %zu chunks left over by %zu threads\n", next, count, chunk_count, thread_count);
+#endif
+
+  return;
+}
+
+/*
+ * the chunk is recorded in ctx->cursors as it is claimed, so that a checkpoint never misses it
+ * returns the first array of the chunk, SIZE_MAX once every array was claimed
+ */
+static size_t claim_chunk(mt_context *ctx, size_t thread_idx)
+{
+  size_t first = SIZE_MAX;
+
+  pthread_mutex_lock(&ctx->mutex);
+  if (ctx->pending_count > 0)
+    first = ctx->pending[--ctx->pending_count];
+  else if (ctx->next < ctx->count)
+  {
+    first = ctx->next;
+    ctx->next += ctx->chunk_size;
+  }
+  ctx->cursors[thread_idx] = first;
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return first;
+}
+
+static void finish_chunk(mt_context *ctx, size_t thread_idx)
+{
+  pthread_mutex_lock(&ctx->mutex);
+  ctx->cursors[thread_idx] = SIZE_MAX;
+  pthread_mutex_unlock(&ctx->mutex);
+}
+
+// set from the SIGINT handler, the display thread stops the scan when it sees it
+static volatile sig_atomic_t latin_square_scan_interrupted = 0;
+
+static void interrupt_latin_square_scan(int sig)
+{
+  (void) sig;
+  latin_square_scan_interrupted = 1;
 }
 
 typedef struct
 {
-  latin_square* P, * Q;   // arrays where to store the read latin squares
-  pthread_t thread;       //
-  size_t thread_idx;      //
-  size_t count;           // number of latin squares to read
-  action func;            // callback
-  void* data;             // data to pass to the callback
-  uint8_t* latin_squares; // where to read the latin_squares
-  perf_counter perf;      // store the performance data
+  pthread_t thread;             //
+  size_t thread_idx;            //
+  action_batch func;            // callback
+  void* data;                   // data to pass to the callback
+  const uint8_t* latin_squares; // all the latin square arrays, shared by the threads, NULL if they are generated
+  const uint8_t* inv_maps;      // their latin_squares_inv, NULL if there is no companion file
+  uint8_t* buffer;              // where the generated arrays are written
+  perf_counter perf;            // store the performance data
   mt_context* ctx;
 } thread_data;
 
@@ -63,10 +246,27 @@ static void* display_thread_worker(void* arg)
 {
   display_pack* pack = arg;
   mt_context* ctx = pack->ctx;
+  timer since_checkpoint;
+  timer_start(&since_checkpoint);
 
   // dont need a mutex here since we are just reading
   while (!pack->ctx->stop_flag)
   {
+    if (latin_square_scan_interrupted)
+    {
+      pthread_mutex_lock(&ctx->mutex);
+      ctx->stop_flag   = 1;
+      ctx->interrupted = 1;
+      pthread_mutex_unlock(&ctx->mutex);
+      break;
+    }
+
+    if (timer_stop(&since_checkpoint) >= LATIN_SQUARE_CHECKPOINT_PERIOD)
+    {
+      save_latin_square_checkpoint(ctx);
+      timer_start(&since_checkpoint);
+    }
+
     ctx->total_iterations = 0;
     for (size_t thread_idx = 0; thread_idx < pack->thread_count; ++thread_idx)
       ctx->total_iterations += pack->datas[thread_idx].perf.counter;
@@ -117,47 +317,271 @@ static void* thread_worker(void* arg)
   mt_context* ctx = data->ctx;
   const uint32_t r = ctx->r;
   const uint32_t s = ctx->s;
+  const size_t square_array_ele = r * s*s + s * r*r;
 
-  uint8_t* arr = data->latin_squares;
-  for (data->perf.counter = 0, data->perf.lcounter = 0;
-       data->perf.counter < data->count;
-       perf_counter_tick(&data->perf))
+  data->perf.counter = 0;
+  data->perf.lcounter = 0;
+  while (!ctx->stop_flag)
   {
-    if (ctx->stop_flag)
+    // claim the next chunk of arrays, every array is claimed by exactly one thread
+    const size_t first = claim_chunk(ctx, data->thread_idx);
+    if (first == SIZE_MAX)
       break;
+    const size_t last = first + ctx->chunk_size < ctx->count ? first + ctx->chunk_size : ctx->count;
 
-    for (uint32_t i = 0; i < r; ++i, arr += s*s)
+    const uint8_t* arrays = NULL;
+    const uint8_t* maps = NULL;
+    if (data->latin_squares != NULL)
     {
-      (data->P + i)->arr = arr;
-      if (!is_latin_square(data->P[i]))
-      {
-        fprintf(stderr, "[UNREACHABLE] latin square P[%u], index number %zu (thread %zu) was not a latin square\n", i, data->thread_idx * data->count + data->perf.counter, data->thread_idx);
-      }
+      // the chunk is handed as is from the mapping, the maps of an array take as many bytes as the array itself
+      arrays = data->latin_squares + first * square_array_ele;
+      maps = data->inv_maps == NULL ? NULL : data->inv_maps + first * square_array_ele;
     }
-    for (uint32_t j = 0; j < s; ++j, arr += r*r)
+    else
     {
-      (data->Q + j)->arr = arr;
-      if (!is_latin_square(data->Q[j]))
-      {
-        fprintf(stderr, "[UNREACHABLE] latin square Q[%u], index number %zu (thread %zu) was not a latin square\n", j, data->thread_idx * data->count + data->perf.counter, data->thread_idx);
-      }
+      for (size_t idx = first; idx < last; ++idx)
+        latin_square_array_unrank(data->buffer + (idx - first) * square_array_ele, idx, r, s);
+      arrays = data->buffer;
     }
 
-    if (!(*data->func)(data->P, r, data->Q, s, data->data))
+    const uint8_t cont = (*data->func)(arrays, maps, last - first, r, s, data->data);
+    perf_counter_add(&data->perf, last - first);
+
+    if (!cont)
     {
       pthread_mutex_lock(&ctx->mutex);
       ctx->stop_flag = 1;
       pthread_mutex_unlock(&ctx->mutex);
     }
+    else
+      finish_chunk(ctx, data->thread_idx);
   }
 
   return NULL;
 }
 
-uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, const char*const name, size_t thread_count, perf_counter* perf, action func, void* init_data(void*), void clear_data(void *), void* data)
+/*
+ * runs func on every array of ctx, with the threads claiming chunks as they go
+ * the arrays are read from latin_squares and inv_maps, or generated from latin_square_table if latin_squares is NULL
+ * with a checkpoint_file in ctx, the scan starts from it if it exists, saves to it every LATIN_SQUARE_CHECKPOINT_PERIOD
+ * seconds and upon SIGINT, after which the program exits, and removes it once done
+ */
+static void run_on_all_latin_square_arrays_mt(mt_context* ctx, size_t thread_count, perf_counter* perf, action_batch func, void* init_data(void*), void clear_data(void *), void* data,
+                                              const uint8_t* latin_squares, const uint8_t* inv_maps)
+{
+  const size_t square_array_ele = ctx->r * ctx->s*ctx->s + ctx->s * ctx->r*ctx->r;
+
+  /*
+   * allocate thread data
+   */
+  thread_data* datas = calloc(thread_count, sizeof(thread_data));
+  ctx->cursors = malloc(thread_count * sizeof(size_t));
+  if (datas == NULL || ctx->cursors == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+  for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
+    ctx->cursors[thread_idx] = SIZE_MAX;
+  ctx->thread_count = thread_count;
+
+  // before the buffers are allocated, the chunk size is the one of the checkpoint
+  load_latin_square_checkpoint(ctx);
+
+  struct sigaction interrupt = {.sa_handler = interrupt_latin_square_scan}, previous;
+  sigemptyset(&interrupt.sa_mask);
+  if (ctx->checkpoint_file != NULL)
+  {
+    latin_square_scan_interrupted = 0;
+    sigaction(SIGINT, &interrupt, &previous);
+  }
+
+  /*
+   * start the display thread
+   */
+  display_pack display_thread_pack = {.ctx = ctx, .datas = datas, .thread_count = thread_count};
+  pthread_create(&ctx->display_thread, NULL, display_thread_worker, &display_thread_pack);
+
+  for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
+  {
+    datas[thread_idx].latin_squares = latin_squares;
+    datas[thread_idx].inv_maps      = inv_maps;
+    if (latin_squares == NULL)
+    {
+      // where the generated chunk is written
+      datas[thread_idx].buffer = malloc(ctx->chunk_size * square_array_ele);
+      if (datas[thread_idx].buffer == NULL)
+      {
+        fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+        exit(1);
+      }
+    }
+
+    /*
+     * set all the random data
+     */
+    perf_counter_init(&datas[thread_idx].perf, perf->lspeed_window);
+
+    datas[thread_idx].func       = func;
+    datas[thread_idx].data       = init_data(data);
+    datas[thread_idx].ctx        = ctx;
+    datas[thread_idx].thread_idx = thread_idx;
+
+    /*
+     * start the thread
+     */
+    pthread_create(&datas[thread_idx].thread, NULL, thread_worker, &datas[thread_idx]);
+  }
+
+  for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
+  {
+    pthread_join(datas[thread_idx].thread, NULL);
+
+    // free the threads personnal data
+    free(datas[thread_idx].buffer);
+    clear_data(datas[thread_idx].data);
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  ctx->stop_flag = 1;
+  pthread_mutex_unlock(&ctx->mutex);
+  pthread_join(ctx->display_thread, NULL);
+
+  free(datas);
+
+  if (ctx->checkpoint_file != NULL)
+  {
+    sigaction(SIGINT, &previous, NULL);
+
+    // the threads all finished their chunks: the checkpoint is exact
+    if (ctx->interrupted)
+    {
+      save_latin_square_checkpoint(ctx);
+      fprintf(stderr, "[INFO] Interrupted, the scan was saved to %s, pick it up with -resume\n", ctx->checkpoint_file);
+      exit(1);
+    }
+    remove(ctx->checkpoint_file);
+  }
+
+  return;
+}
+
+/*
+ * offline check of a .latin_square file, which action_on_all_latin_square_arrays_mt does not do on the way
+ * returns the number of arrays holding a square which is not latin
+ */
+size_t verify_all_latin_square_arrays(const char*const base_file_name, const char*const name)
+{
+  FILE* f = fopen(temp_sprintf("%s%s.latin_square", base_file_name, name), "r");
+  if (f == NULL)
+  {
+    fprintf(stderr, "[ERROR] Could not read file: %s\n", strerror(errno));
+    exit(1);
+  }
+
+  size_t count;
+  uint32_t r, s;
+  fread(&count, sizeof(count), 1, f);
+  fread(&r,     sizeof(r),     1, f);
+  fread(&s,     sizeof(s),     1, f);
+
+  const size_t header_size      = sizeof(count) + sizeof(r) + sizeof(s);
+  const size_t square_array_ele = r * s*s + s * r*r;
+  const size_t file_size        = count * square_array_ele + header_size;
+
+  uint8_t* file = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fileno(f), 0);
+  fclose(f);
+  if (file == MAP_FAILED)
+  {
+    fprintf(stderr, "[ERROR] Could not mmap file %u: %s\n", errno, strerror(errno));
+    exit(1);
+  }
+
+  size_t invalid = 0;
+  const uint8_t* arr = file + header_size;
+  uint8_t canonical[2 * 16 * 16 * 16];
+  for (size_t idx = 0; idx < count; ++idx, arr += square_array_ele)
+  {
+    uint8_t valid = 1;
+    // is_latin_square does not write to the square
+    for (uint32_t i = 0; i < r; ++i)
+      valid &= is_latin_square((latin_square){.n = s, .arr = (uint8_t*)arr + i * s*s});
+    for (uint32_t j = 0; j < s; ++j)
+      valid &= is_latin_square((latin_square){.n = r, .arr = (uint8_t*)arr + r * s*s + j * r*r});
+
+    if (!valid)
+    {
+      fprintf(stderr, "[ERROR] latin square array number %zu holds a square which is not latin\n", idx);
+      ++invalid;
+      continue;
+    }
+
+    // the search tests one array per class, see latin_square_array_canonicalize
+    memcpy(canonical, arr, square_array_ele);
+    latin_square_array_canonicalize(canonical, NULL, NULL, r, s);
+    if (memcmp(canonical, arr, square_array_ele) != 0)
+    {
+      fprintf(stderr, "[ERROR] latin square array number %zu is not the representative of its class\n", idx);
+      ++invalid;
+    }
+  }
+
+  munmap(file, file_size);
+  return invalid;
+}
+
+/*
+ * mmaps the companion .latin_square_inv file written at -regen, of size file_size
+ * returns NULL if there is none or if it does not match the .latin_square file, the maps are then computed per array
+ */
+static uint8_t* map_latin_squares_inv(const char*const base_file_name, const char*const name, size_t count, uint32_t r, uint32_t s, size_t file_size)
+{
+  const char* file_name = temp_sprintf("%s%s.latin_square_inv", base_file_name, name);
+  FILE* f = fopen(file_name, "r");
+  if (f == NULL)
+    return NULL;
+
+  size_t inv_count = 0;
+  uint32_t inv_r = 0, inv_s = 0;
+  const uint8_t ok = fread(&inv_count, sizeof(inv_count), 1, f) == 1
+                  && fread(&inv_r,     sizeof(inv_r),     1, f) == 1
+                  && fread(&inv_s,     sizeof(inv_s),     1, f) == 1;
+  if (!ok || inv_count != count || inv_r != r || inv_s != s)
+  {
+    fprintf(stderr, "[WARNING] Ignoring %s: it does not match the latin square arrays, run with -regen\n", file_name);
+    fclose(f);
+    return NULL;
+  }
+
+  uint8_t* maps = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fileno(f), 0);
+  fclose(f);
+  if (maps == MAP_FAILED)
+  {
+    fprintf(stderr, "[WARNING] Could not mmap file %s: %s\n", file_name, strerror(errno));
+    return NULL;
+  }
+
+#ifndef __NO_GUI__
+  printw("Mmaped %zu bytes for the latin_squares_inv of the arrays\n", file_size);
+#else
+  printf("Mmaped %zu bytes for the latin_squares_inv of the arrays\n", file_size);
+#endif
+
+  return maps;
+}
+
+/*
+ * the arrays are handed to the threads by chunks of chunk_size (DEFAULT_LATIN_SQUARE_CHUNK if 0) as they go,
+ * func gets each chunk at once
+ * the progress is saved to checkpoint_file if it is not NULL, tag tells apart the scans which can resume from it
+ * the squares are not checked on the way, see verify_all_latin_square_arrays
+ */
+uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, const char*const name, size_t thread_count, size_t chunk_size, const char*const checkpoint_file, uint64_t tag, perf_counter* perf, action_batch func, void* init_data(void*), void clear_data(void *), void* data)
 {
   if (thread_count <= 0)
     thread_count = 1;
+  if (chunk_size <= 0)
+    chunk_size = DEFAULT_LATIN_SQUARE_CHUNK;
 
   /*
    * get the info about the latin square list
@@ -188,14 +612,14 @@ uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, co
                                  fileno(f),
                                  0);
 
-  latin_squares += header_ele; // skip the count, r, s header
-
   if (latin_squares == MAP_FAILED)
   {
     fprintf(stderr, "[ERROR] Could not mmap file %u: %s\n", errno, strerror(errno));
     exit(1);
   }
 
+  latin_squares += header_ele; // skip the count, r, s header
+
 #ifndef __NO_GUI__
   printw("Mmaped %zu bytes for latin square array\n", count * square_array_size + header_size);
 #else
@@ -204,81 +628,63 @@ uint8_t action_on_all_latin_square_arrays_mt(const char*const base_file_name, co
 
   fclose(f);
 
+  const size_t inv_file_size = count * square_array_size + header_size;
+  uint8_t* inv_file = map_latin_squares_inv(base_file_name, name, count, r, s, inv_file_size);
+  uint8_t* inv_maps = inv_file == NULL ? NULL : inv_file + header_size;
 
-  /*
-   * allocate thread data
-   */
-  thread_data* datas = calloc(thread_count, sizeof(thread_data));
   mt_context ctx;
   mt_context_init(&ctx, r, s);
+  ctx.count           = count;
+  ctx.chunk_size      = chunk_size;
+  ctx.checkpoint_file = checkpoint_file;
+  ctx.tag             = tag;
 
-  /*
-   * start the display thread
-   */
-  display_pack display_thread_pack = {.ctx = &ctx, .datas = datas, .thread_count = thread_count};
-  pthread_create(&ctx.display_thread, NULL, display_thread_worker, &display_thread_pack);
+  run_on_all_latin_square_arrays_mt(&ctx, thread_count, perf, func, init_data, clear_data, data, latin_squares, inv_maps);
 
-  const size_t step_size = count / thread_count;
+  mt_context_free(&ctx);
+  munmap(latin_squares - header_ele, count * square_array_size + header_size);
+  if (inv_file != NULL)
+    munmap(inv_file, inv_file_size);
 
-  for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
-  {
-    /*
-     * prepare the latin squares arrays
-     */
-    datas[thread_idx].P = calloc(r, sizeof(latin_square));
-    datas[thread_idx].Q = calloc(s, sizeof(latin_square));
-    if (datas[thread_idx].P == NULL || datas[thread_idx].Q == NULL)
-    {
-      fprintf(stderr, "[OoM] Buy more RAM LOL!!\n");
-      exit(1);
-    }
-    // dont need to actually init since we will point P.arr to a part of latin_squares
-    for (uint32_t i = 0; i < r; ++i)
-      (datas[thread_idx].P + i)->n = s;
-    for (uint32_t j = 0; j < s; ++j)
-      (datas[thread_idx].Q + j)->n = r;
+  return 0;
+}
 
-    /*
-     * Set the correct pointer for latin squares array
-     */
-    datas[thread_idx].latin_squares = latin_squares + thread_idx * step_size * square_array_ele;
 
-    /*
-     * set all the random data
-     */
-    perf_counter_init(&datas[thread_idx].perf, perf->lspeed_window);
-
-    datas[thread_idx].count      = step_size;
-    datas[thread_idx].func       = func;
-    datas[thread_idx].data       = init_data(data);
-    datas[thread_idx].ctx        = &ctx;
-    datas[thread_idx].thread_idx = thread_idx;
+/*
+ * same as action_on_all_latin_square_arrays_mt, without any file: the threads generate their chunks from the
+ * latin_square_table of side r and s, kept in memory
+ * the arrays come in the same order as in the .latin_square file and there are as many
+ */
+uint8_t action_on_all_generated_latin_square_arrays_mt(uint32_t r, uint32_t s, size_t thread_count, size_t chunk_size, const char*const checkpoint_file, uint64_t tag, perf_counter* perf, action_batch func, void* init_data(void*), void clear_data(void *), void* data)
+{
+  if (thread_count <= 0)
+    thread_count = 1;
+  if (chunk_size <= 0)
+    chunk_size = DEFAULT_LATIN_SQUARE_CHUNK;
 
-    /*
-     * start the thread
-     */
-    pthread_create(&datas[thread_idx].thread, NULL, thread_worker, &datas[thread_idx]);
+  const size_t count = number_of_latin_square_arrays(r, s);
+  if (count == 0)
+  {
+    fprintf(stderr, "[ERROR] There are too many arrays of %u latin squares of side %u and %u of side %u to index them\n", r, s, s, r);
+    exit(1);
   }
 
-  for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
-  {
-    pthread_join(datas[thread_idx].thread, NULL);
+#ifndef __NO_GUI__
+  printw("Generating %zu latin square arrays from %zu squares of side %u and %zu of side %u\n", count, latin_square_table(s)->count, s, latin_square_table(r)->count, r);
+#else
+  printf("Generating %zu latin square arrays from %zu squares of side %u and %zu of side %u\n", count, latin_square_table(s)->count, s, latin_square_table(r)->count, r);
+#endif
 
-    // free the threads personnal data
-    // the squares dont need to be cleared since their arrays haven't actually been allocated
-    free(datas[thread_idx].P);
-    free(datas[thread_idx].Q);
-    clear_data(datas[thread_idx].data);
-  }
+  mt_context ctx;
+  mt_context_init(&ctx, r, s);
+  ctx.count           = count;
+  ctx.chunk_size      = chunk_size;
+  ctx.checkpoint_file = checkpoint_file;
+  ctx.tag             = tag;
 
-  pthread_mutex_lock(&ctx.mutex);
-  ctx.stop_flag = 1;
-  pthread_mutex_unlock(&ctx.mutex);
-  pthread_join(ctx.display_thread, NULL);
+  run_on_all_latin_square_arrays_mt(&ctx, thread_count, perf, func, init_data, clear_data, data, NULL, NULL);
 
-  free(datas);
-  munmap(latin_squares, count * square_array_size);
+  mt_context_free(&ctx);
 
   return 0;
 }
-
@@ -23,8 +23,17 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
 #include "find_sets.h"
+#include "hshtbl.h"
+#include "rng.h"
 #include "pow_m_sqr.h"
 #include "arithmetic.h"
 
@@ -139,232 +148,179 @@ uint8_t iterate_over_sets_callback_inside(sets_search_data *d, uint32_t current_
 
 // ----------- collision method ---------------
 
-#define HSHTBL_BASE_SIZE (32)
-#define HSHTBL_FULLNESS_RATIO (0.7)
-#define HSHTBL_MAX_FULLNESS_RATIO (0.70)
-#define HSHTBL_MAX_SIZE ((1<<25) - 1)
-
-typedef struct hshtbl_node_s
-{
-  uint64_t sum;
-  rel_item *items;
-} hshtbl_node;
+#define PREFILL_CAP 3
 
-typedef struct
-{
-  size_t count, capacity;
-  hshtbl_node *arr;
-} hshtbl;
+// mask of the k <= 32 lowest bits, blocs and bloc masks hold r * s <= 32 bits (see init_state_buffers)
+#define BITS_MASK(k) ((uint32_t)((1ULL << (k)) - 1))
 
 /*
- * hshtbl format:
- * arr is an array of capacity hshtbl_nodes
- * a node is non-empty iff its items field is non-NULL
- * collisions are resolved by finding the next (mod capacity) empty slot in arr
+ * the partial sets of at most PREFILL_CAP entries whose smallest entry is first, by number of entries,
+ * each in lexicographic order
+ * sums[w] and items[w] hold the binomial(n*n - 1 - first, w) partial sets of w + 1 entries
  */
-
-void init_hshtbl(hshtbl* h)
+typedef struct
 {
-  h->arr = calloc( HSHTBL_BASE_SIZE, sizeof(hshtbl_node));
-  h->capacity = HSHTBL_BASE_SIZE;
-}
-
-#define PREFILL_CAP 3
+  size_t count[PREFILL_CAP];
+  uint64_t *sums[PREFILL_CAP];
+  rel_item *items[PREFILL_CAP]; // count[w] partial sets of w + 1 rel_items
+} prefill_bucket;
 
-/*
- * returns an array of n/2 hshtbls.
- * hshtbl with index k will hold set of postions with k + 1 entries
- */
-hshtbl *init_hshtbls(const uint32_t n)
+typedef struct
 {
-  hshtbl *table = calloc(n/2, sizeof(hshtbl));
-  if (table == NULL)
-  {
-    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
-    exit(1);
-  }
-  for (uint32_t i = 0; i < n/2; ++i)
-    init_hshtbl(table + i);
-  return table;
-}
+  pthread_t id;
+  pow_m_sqr *M;
+  size_t n, k;
+  size_t *next_first;      // next first entry to be claimed, shared by the workers
+  prefill_bucket *buckets; // n*n buckets, one per first entry
+} prefill_worker_data;
 
-void empty_hshtbl(hshtbl *table)
+static void prefill_bucket_inside(prefill_bucket *bucket, pow_m_sqr M, rel_item *rel, size_t p, uint64_t mu, size_t n, size_t k)
 {
-  for (uint32_t i = 0; i < table->capacity; i++)
-    if (table->arr[i].items != NULL)
-      free(table->arr[i].items);
+  const size_t w = p - 1;
+  bucket->sums[w][bucket->count[w]] = mu;
+  memcpy(bucket->items[w] + bucket->count[w] * p, rel, p * sizeof(rel_item));
+  ++bucket->count[w];
 
-  table->count = 0;
+  if (p >= k)
+    return;
 
-  return;
-}
+  // only increasing entries: every set is enumerated once
+  for (size_t i = rel[p - 1] + 1; i < n*n; ++i)
+  {
+    rel[p] = i;
+    prefill_bucket_inside(bucket, M, rel, p + 1, mu + M_SQR_GET_POW_AS_VEC(M, i), n, k);
+  }
 
-void free_hshtbl(hshtbl *table)
-{
-  empty_hshtbl(table);
-  free(table->arr);
-  table->arr = NULL;
   return;
 }
 
-
-void free_hshtbls(hshtbl *table, const uint32_t n)
+void *prefill_worker(void *arg)
 {
-  for (uint32_t k = 0; k < n/2; ++k)
-    free_hshtbl(table + k);
+  prefill_worker_data *w = (prefill_worker_data*)arg;
+  const size_t entries = w->n * w->n;
+  rel_item rel[PREFILL_CAP];
 
-  free(table);
+  size_t first;
+  while ((first = __atomic_fetch_add(w->next_first, 1, __ATOMIC_RELAXED)) < entries)
+  {
+    prefill_bucket *bucket = w->buckets + first;
+    for (size_t p = 0; p < w->k; ++p)
+    {
+      // one more than needed, calloc might return NULL for an empty bucket
+      const size_t count = binomial(entries - 1 - first, p);
+      bucket->sums[p] = calloc(count + 1, sizeof(uint64_t));
+      bucket->items[p] = calloc((count + 1) * (p + 1), sizeof(rel_item));
+      if (bucket->sums[p] == NULL || bucket->items[p] == NULL)
+      {
+        fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+        exit(1);
+      }
+    }
 
-  return;
-}
+    rel[0] = first;
+    prefill_bucket_inside(bucket, *w->M, rel, 1, M_SQR_GET_POW_AS_VEC(*w->M, first), w->n, w->k);
+  }
 
-static inline uint32_t hash_func(uint64_t x)
-{
-  // from splitmix64
-  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
-  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
-  x = x ^ (x >> 31);
-  return (uint32_t)x;
+  return NULL;
 }
 
 /*
-  set1 and set2 MUST have the same size of count ie set2_selected MUST have exactly count entries equal to 1 and every other being 0
+ * fills the k <= PREFILL_CAP first tables with every partial set of at most k entries
+ * the partial sets are enumerated by thread_count workers, each first entry apart, then inserted in
+ * lexicographic order: the tables do not depend on thread_count
  */
-uint8_t sets_equal_items_selected(const rel_item *set1_items, const uint8_t *set2_selected, const uint64_t count, const uint64_t n)
-{
-  for (uint64_t k = 0; k < count; ++k)
-  {
-    const uint32_t i = set1_items[k] / n;
-    const uint32_t j = set1_items[k] % n;
-    if (!GET_AS_MAT(set2_selected, i, j, n))
-      return 0;
-  }
-
-  return 1;
-}
-
-void hshtbl_resize(hshtbl* table)
+void prefill_hshtbls(hshtbl* tables, pow_m_sqr M, size_t n, size_t k, size_t thread_count)
 {
-  // stop increasing table size
-  if (table->capacity >= HSHTBL_MAX_SIZE) return;
-
-  // table not full
-  if (table->count <= table->capacity * HSHTBL_FULLNESS_RATIO)
-    return;
-
-  const size_t prev_capa = table->capacity;
+  assert(k <= PREFILL_CAP);
+  const size_t entries = n * n;
 
-  while (table->count > table->capacity * HSHTBL_FULLNESS_RATIO)
-    table->capacity *= 2ULL;
+  if (thread_count == 0)
+    thread_count = 1;
 
-  hshtbl_node* bigger = calloc(table->capacity, sizeof(table->arr[0]));
-  if (bigger == NULL)
+  prefill_bucket *buckets = calloc(entries, sizeof(prefill_bucket));
+  prefill_worker_data *workers = calloc(thread_count, sizeof(prefill_worker_data));
+  if (buckets == NULL || workers == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
   }
 
-  for (size_t i = 0; i < prev_capa; ++i)
+  size_t next_first = 0;
+  for (size_t t = 0; t < thread_count; ++t)
   {
-    if (table->arr[i].items != NULL)
-    {
-      uint32_t h = hash_func(table->arr[i].sum) % table->capacity;
-      while (bigger[h].items)
-        h = (h + 1) % table->capacity;
+    workers[t] = (prefill_worker_data) {
+      .M = &M, .n = n, .k = k, .next_first = &next_first, .buckets = buckets
+    };
+    if (thread_count == 1)
+      prefill_worker(workers + t);
+    else
+      pthread_create(&workers[t].id, NULL, prefill_worker, workers + t);
+  }
+  if (thread_count > 1)
+    for (size_t t = 0; t < thread_count; ++t)
+      pthread_join(workers[t].id, NULL);
 
-      bigger[h] = table->arr[i];
+  // no duplicates by construction
+  for (size_t p = 0; p < k; ++p)
+    for (size_t first = 0; first < entries; ++first)
+    {
+      prefill_bucket *bucket = buckets + first;
+      for (size_t c = 0; c < bucket->count[p]; ++c)
+        hshtbl_insert_unique(tables + p, bucket->items[p] + c * (p + 1), p + 1, bucket->sums[p][c]);
+      free(bucket->sums[p]);
+      free(bucket->items[p]);
     }
-  }
 
-  free(table->arr);
-  table->arr = bigger;
+  free(buckets);
+  free(workers);
 
   return;
 }
 
-enum HSHTBL_STATUS
-{
-  HSHTBL_OK,
-  HSHTBL_FULL,
-  HSHTBL_STATUS_COUNT,
-};
-
 /*
- * modifies table
- * items and selected are different representations of the same data
+ * FNV-1a of everything the prefilled tables depend on
  */
-uint8_t hshtbl_insert(hshtbl *table, const rel_item *items, const uint8_t *selected, const uint32_t count, const uint64_t sum, const uint64_t n)
+static uint64_t prefill_key(pow_m_sqr M, size_t n)
 {
-  if (table->count > HSHTBL_MAX_FULLNESS_RATIO * table->capacity)
-    return HSHTBL_FULL;
-
-  uint64_t h = hash_func(sum) % table->capacity;
-
-  // there should always be space in the hshtbl has its occupancy must never be above HSHTBL_FULLNESS_RATIO
-  hshtbl_node node = table->arr[h];
-  while (node.items)
-  {
-    if (sets_equal_items_selected(node.items, selected, count, n))
-      return HSHTBL_OK; // duplicate
-    h = (h + 1) % table->capacity;
-    node = table->arr[h];
-  };
-
-  node.sum = sum;
-  node.items = calloc(count, sizeof(rel_item));
-  if (node.items == NULL)
-  {
-    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
-    exit(1);
-  }
-  memcpy(node.items, items, count * sizeof(rel_item));
-
-  table->arr[h] = node;
-  ++table->count;
-
-  hshtbl_resize(table);
+  uint64_t key = 14695981039346656037ULL;
+  key = (key ^ n) * 1099511628211ULL;
+  key = (key ^ PREFILL_CAP) * 1099511628211ULL;
+  key = (key ^ sizeof(hshtbl_node)) * 1099511628211ULL;
+  key = (key ^ sizeof(rel_item)) * 1099511628211ULL;
+  for (size_t i = 0; i < n*n; ++i)
+    key = (key ^ M_SQR_GET_POW_AS_VEC(M, i)) * 1099511628211ULL;
 
-  return HSHTBL_OK;
+  return key;
 }
 
-void prefill_hshtbls_inside(hshtbl* tables, pow_m_sqr M, rel_item* rel, uint8_t* selected, size_t p, size_t mu, size_t n, size_t k)
+/*
+ * the PREFILL_CAP first tables only depend on M: if prefill_dir is not NULL, the first run on a square saves them
+ * to SETS_PREFILL_NAME there and the next ones map them read only from there instead of enumerating them again
+ */
+static void prefill_or_map_hshtbls(hshtbl *tables, pow_m_sqr M, size_t n, size_t thread_count, const char *prefill_dir, hshtbls_mapping *mapping)
 {
-  if (p >= 1)
-    hshtbl_insert(tables + p - 1, rel, selected, p, mu, n);
-
-  if (p >= k)
-    return;
-
-  for (size_t i = 0; i < n*n; ++i)
+  if (prefill_dir == NULL)
   {
-    if (selected[i])
-      continue;
-
-    rel[p] = i;
-    selected[i] = 1;
-    prefill_hshtbls_inside(tables, M, rel, selected, p + 1,
-        mu + ui_pow_ui(M_SQR_GET_AS_VEC(M, i), M.d),
-        n, k);
-    selected[i] = 0;
+    prefill_hshtbls(tables, M, n, PREFILL_CAP, thread_count);
+    return;
   }
 
-  return;
-}
+  const uint64_t key = prefill_key(M, n);
+  char file[512];
+  snprintf(file, sizeof(file), "%s" SETS_PREFILL_NAME, prefill_dir, key);
 
-void prefill_hshtbls(hshtbl* tables, pow_m_sqr M, size_t n, size_t k)
-{
-  rel_item* rel = calloc(k, sizeof(rel_item));
-  uint8_t* selected = calloc(n*n, sizeof(uint8_t));
-  if (rel == NULL || selected == NULL)
+  if (map_hshtbls(file, tables, PREFILL_CAP, key, mapping))
   {
-    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
-    exit(1);
+#ifndef __NO_GUI__
+    printw("Mmaped %zu bytes of prefilled tables from %s\n", mapping->size, file);
+#else
+    printf("Mmaped %zu bytes of prefilled tables from %s\n", mapping->size, file);
+#endif
+    return;
   }
 
-  prefill_hshtbls_inside(tables, M, rel, selected, 0, 0, n, k);
-
-  free(rel);
-  free(selected);
+  prefill_hshtbls(tables, M, n, PREFILL_CAP, thread_count);
+  save_hshtbls(file, tables, PREFILL_CAP, key);
 
   return;
 }
@@ -383,32 +339,61 @@ typedef struct regime_data_s
   double speed, peak_speed, peak_local_speed;
 } regime_data;
 
+/*
+ * data shared by all the workers of find_sets_collision_method_mt
+ */
+typedef struct
+{
+  found_set_table found;       // already found solutions
+  pthread_mutex_t found_mutex; // guards found, the callback, the perf_counter and the screen
+  hshtbl *tables;              // array of n/2 hshtbls, only the PREFILL_CAP first ones are used and are read only once prefilled
+  hshtbls_mapping prefill_mapping; // where the prefilled tables are, if they were mapped
+  lf_hshtbl *lf_tables;        // array of n/2 lock-free tables, only the ones from PREFILL_CAP on are used
+  pthread_rwlock_t reset_lock; // held for reading while drawing sets and for writing while emptying the tables
+  uint8_t reset_pending;       // set while waiting for the reset_lock, workers do not start new draws then
+  uint8_t stop_flag;
+  FILE *log;                   // where the found sets are appended, NULL for none, guarded by found_mutex
+} collision_shared;
+
 typedef struct
 {
   uint64_t mu;
   pow_m_sqr *M;
-  hshtbl found;     // pointer to single hshtbl to store already found solutions
+  found_set_table *found; // already found solutions
+  FILE *log;         // where the found sets are appended, NULL for none
   hshtbl *tables;    // array of hshtbls of size n/2
+  hshtbls_mapping prefill_mapping; // where the prefilled tables are, if they were mapped
+  collision_shared *shared; // NULL when single threaded, otherwise found and the tables belong to it
   uint8_t *selected; // matrix of bools of size n x n
   uint32_t *row_sum, *row_sum_copy; // array of size s
   uint32_t *col_sum, *col_sum_copy; // array of size r
   rel_item *items, *items2;   // array of size n
-  // lists of entry indices of open blocs/cells, there are at most r * s
-  // they are both array of size r * s = s * r = n
-  uint32_t *open_blocs;
-  uint32_t *open_entries_in_bloc;
+  /*
+   * bitboard of selected, for the random draws
+   * bloc_masks[bi * r + bj] has bit i * s + j set iff the entry (i, j) of the bloc is selected
+   * open_blocs_mask has bit bi * r + bj set iff the bloc can still receive an entry
+   */
+  uint32_t *bloc_masks;
+  uint32_t open_blocs_mask;
+  rng rng;
+  // items of the partial sets matching a collision, copied out of the tables
+  rel_item *candidates;
+  size_t candidates_capacity; // in number of sets of n rel_items
   uint8_t regime;
   regime_data time_data[REGIME_COUNT];
 } state;
 
-void init_state(state *pack, pow_m_sqr* M, const uint32_t r, const uint32_t s)
+/*
+ * allocates the fields that are specific to one iteration of the algorithm
+ */
+void init_state_buffers(state *pack, pow_m_sqr* M, const uint32_t r, const uint32_t s)
 {
   const size_t n = r * s;
+  // open_blocs_mask has one bit per bloc, and each bloc mask one bit per entry of the bloc
+  assert(n <= 32 && "open_blocs_mask holds one bit per bloc in a uint32_t");
+  assert(r * s <= 8 * sizeof(*pack->bloc_masks) && "bloc_masks hold one bit per entry of a bloc");
   pack->M = M;
 
-  pack->tables = init_hshtbls(r * s);
-  init_hshtbl(&pack->found);
-
   pack->selected = calloc(n * n, sizeof(uint8_t));
   pack->row_sum = calloc(s, sizeof(uint32_t));
   pack->col_sum = calloc(r, sizeof(uint32_t));
@@ -418,19 +403,59 @@ void init_state(state *pack, pow_m_sqr* M, const uint32_t r, const uint32_t s)
   pack->items = calloc(n, sizeof(rel_item));
   pack->items2 = calloc(n, sizeof(rel_item));
 
-  // lists of entry indices of open blocs/cells, there are at most r * s
-  pack->open_blocs = calloc(r * s, sizeof(uint32_t));
-  pack->open_entries_in_bloc = calloc(r * s, sizeof(uint32_t));
+  // there are r * s blocs of r * s entries
+  pack->bloc_masks = calloc(r * s, sizeof(uint32_t));
+
+  pack->candidates_capacity = 16;
+  pack->candidates = calloc(pack->candidates_capacity * n, sizeof(rel_item));
+
+  if (pack->selected == NULL || pack->row_sum == NULL || pack->col_sum == NULL || pack->items == NULL || pack->bloc_masks == NULL || pack->candidates == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  return;
+}
+
+/*
+ * capacity of the lock-free table of the partial sets of width entries:
+ * the smallest power of 2 holding all of them below HSHTBL_MAX_FULLNESS_RATIO, at most LF_HSHTBL_CAPACITY
+ */
+static size_t lf_hshtbl_capacity(const size_t n, const uint32_t width)
+{
+  // binomial(n * n, width), in floating point as it overflows for the widest partial sets
+  double partial_sets = 1.0;
+  for (uint32_t i = 1; i <= width; ++i)
+    partial_sets = partial_sets * (double)(n * n - width + i) / i;
+
+  size_t capacity = HSHTBL_BASE_SIZE;
+  while (capacity < LF_HSHTBL_CAPACITY && capacity * HSHTBL_MAX_FULLNESS_RATIO < partial_sets)
+    capacity *= 2;
+
+  return capacity;
+}
+
+void init_state(state *pack, pow_m_sqr* M, const uint32_t r, const uint32_t s, const size_t expected_sets, const char *prefill_dir)
+{
+  const size_t n = r * s;
+
+  init_state_buffers(pack, M, r, s);
 
-  if (pack->selected == NULL || pack->row_sum == NULL || pack->col_sum == NULL || pack->items == NULL || pack->open_blocs == NULL || pack->open_entries_in_bloc == NULL)
+  pack->rng = rng_split_global();
+  pack->shared = NULL;
+  pack->tables = init_hshtbls(r * s);
+  pack->found = calloc(1, sizeof(found_set_table));
+  if (pack->found == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
   }
+  init_found_set_table(pack->found, n, expected_sets);
 
   pack->regime = REGIME_PREFILL;
 
-  prefill_hshtbls(pack->tables, *pack->M, n, PREFILL_CAP);
+  prefill_or_map_hshtbls(pack->tables, *pack->M, n, 1, prefill_dir, &pack->prefill_mapping);
 
   pack->regime = REGIME_FILL;
 
@@ -450,12 +475,12 @@ void reset_state(state *pack, const uint32_t r, const uint32_t s)
   memset(pack->col_sum_copy, 0, r * sizeof(*pack->col_sum));
   memset(pack->items, 0, n * sizeof(*pack->items));
   memset(pack->items2, 0, n * sizeof(*pack->items));
-  memset(pack->open_blocs, 0, n * sizeof(*pack->open_blocs));
-  memset(pack->open_entries_in_bloc, 0, n * sizeof(*pack->open_entries_in_bloc));
+  memset(pack->bloc_masks, 0, n * sizeof(*pack->bloc_masks));
+  pack->open_blocs_mask = BITS_MASK(n);
   return;
 }
 
-void free_state(state pack, const uint32_t r, const uint32_t s)
+void free_state_buffers(state pack)
 {
   free(pack.selected);
   free(pack.row_sum);
@@ -464,59 +489,158 @@ void free_state(state pack, const uint32_t r, const uint32_t s)
   free(pack.col_sum_copy);
   free(pack.items);
   free(pack.items2);
-  free(pack.open_blocs);
-  free(pack.open_entries_in_bloc);
+  free(pack.bloc_masks);
+  free(pack.candidates);
+
+  return;
+}
+
+void free_state(state pack, const uint32_t r, const uint32_t s)
+{
+  free_state_buffers(pack);
+
+  // the tables of a worker belong to its collision_shared
+  if (pack.shared != NULL)
+    return;
 
   free_hshtbls(pack.tables, r * s);
-  free_hshtbl(&pack.found);
+  unmap_hshtbls(&pack.prefill_mapping);
+  free_found_set_table(pack.found);
+  free(pack.found);
 
   return;
 }
 
-uint8_t bloc_is_filled(const uint8_t *selected, const uint32_t bi, const uint32_t bj, const uint32_t r, const uint32_t s)
+/*
+ * stores the count first items of pack as a partial set with sum `sum`
+ */
+void state_insert_partial_set(state *pack, const uint32_t count, const uint64_t sum, const uint32_t n)
 {
-  for (uint32_t i = 0; i < r; ++i)
-    for (uint32_t j = 0; j < s; ++j)
-      if (!GET_AS_MAT(selected, bi * r + i, bj * s + j, r * s))
-        return 0;
-  return 1;
+  // -1 because the tables are zero indexed
+  if (pack->shared == NULL)
+  {
+    hshtbl_insert(pack->tables + count - 1, pack->items, pack->selected, count, sum, n);
+    return;
+  }
+
+  lf_hshtbl_insert(pack->shared->lf_tables + count - 1, pack->items, pack->selected, count, sum, n);
+
+  return;
 }
 
 /*
- * returns negative if no open blocs exist
+ * returns where to copy the candidate of index `found` of `width` rel_items
+ */
+rel_item *state_candidate(state *pack, const size_t found, const uint32_t width)
+{
+  if (found >= pack->candidates_capacity)
+  {
+    pack->candidates_capacity *= 2;
+    pack->candidates = realloc(pack->candidates, pack->candidates_capacity * pack->M->n * sizeof(rel_item));
+    if (pack->candidates == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+  }
+
+  return pack->candidates + found * width;
+}
+
+/*
+ * copies the items of every entry of table with sum `key` to pack->candidates, after the `found` first ones
+ * returns the new number of candidates
  */
-int32_t select_open_bloc(const uint8_t *selected, const uint32_t *col_sum, const uint32_t *row_sum, uint32_t *open_blocs, const uint32_t r, const uint32_t s)
+size_t gather_collision_candidates(state *pack, const hshtbl *table, const uint64_t key, size_t found)
+{
+  for (uint32_t h = hash_func(key) % table->capacity; table->arr[h].item; h = (h + 1) % table->capacity)
+  {
+    const hshtbl_node node = table->arr[h];
+    if (node.sum != key)
+      continue;
+
+    memcpy(state_candidate(pack, found, table->width), HSHTBL_NODE_ITEMS(table, node), table->width * sizeof(rel_item));
+    ++found;
+  }
+
+  return found;
+}
+
+size_t gather_collision_candidates_lf(state *pack, const lf_hshtbl *table, const uint64_t key, size_t found)
 {
-  uint32_t open_blocs_cnt = 0;
+  for (int64_t h = lf_hshtbl_find_next(table, key, -1); h >= 0; h = lf_hshtbl_find_next(table, key, h))
+  {
+    memcpy(state_candidate(pack, found, table->width), LF_HSHTBL_SLOT_ITEMS(table, h), table->width * sizeof(rel_item));
+    ++found;
+  }
+
+  return found;
+}
 
-  // iterate over all s bloc rows
-  for (uint32_t bi = 0; bi < s; ++bi)
-    // iterate over all r bloc columns
-    for (uint32_t bj = 0; bj < r; ++bj)
-      if (row_sum[bi] < r && col_sum[bj] < s && !bloc_is_filled(selected, bi, bj, r, s))
-        open_blocs[open_blocs_cnt++] = bi * r + bj; // width of array is r, as there are r column blocs
+/*
+ * returns the index of the k-th (from 0) set bit of mask, which must have more than k set bits
+ */
+static inline uint32_t select_kth_bit(uint32_t mask, uint32_t k)
+{
+#ifdef __BMI2__
+  return __builtin_ctz(_pdep_u32(1U << k, mask));
+#else
+  for (; k > 0; --k)
+    mask &= mask - 1; // clear lowest set bit
+  return __builtin_ctz(mask);
+#endif
+}
 
+/*
+ * returns negative if no open blocs exist
+ */
+int32_t select_open_bloc(state *pack)
+{
+  const uint32_t open_blocs_cnt = __builtin_popcount(pack->open_blocs_mask);
   if (open_blocs_cnt == 0)
     return -1;
 
   // get one entry from the list we selected
-  return open_blocs[rand() % open_blocs_cnt]; // don't care about proper random uniform distribution
+  return select_kth_bit(pack->open_blocs_mask, rng_bounded(&pack->rng, open_blocs_cnt));
 }
 
-uint32_t select_open_entry_in_bloc(const uint8_t *selected, uint32_t *open_entries_in_bloc,
-                                   const uint32_t bi, const uint32_t bj, const uint32_t r, const uint32_t s)
+uint32_t select_open_entry_in_bloc(state *pack, const uint32_t bi, const uint32_t bj, const uint32_t r, const uint32_t s)
 {
-  // iterate over all r columns in a bloc
-  uint32_t open_entries_in_bloc_cnt = 0;
-  for (uint32_t i = 0; i < r; ++i)
-    // iterate over all s columns in a bloc
-    for (uint32_t j = 0; j < s; ++j)
-      if (!GET_AS_MAT(selected, bi * r + i, bj * s + j, r * s))
-        open_entries_in_bloc[open_entries_in_bloc_cnt++] = (bi * r + i) * (r * s) + (bj * s + j);
+  const uint32_t free_entries = ~pack->bloc_masks[bi * r + bj] & BITS_MASK(r * s);
+  const uint32_t open_entries_in_bloc_cnt = __builtin_popcount(free_entries);
 
   assert(open_entries_in_bloc_cnt > 0 && "Must be non-negative, as only blocs with non-zero amount of non-selected items were chosen in the previous step");
 
-  return open_entries_in_bloc[rand() % open_entries_in_bloc_cnt];
+  const uint32_t k = select_kth_bit(free_entries, rng_bounded(&pack->rng, open_entries_in_bloc_cnt));
+  const uint32_t i = k / s;
+  const uint32_t j = k % s;
+
+  return (bi * r + i) * (r * s) + (bj * s + j);
+}
+
+/*
+ * marks the entry `pos` of the bloc (bi, bj) as selected and closes the blocs which cannot receive any more entries
+ */
+void select_entry(state *pack, const uint32_t pos, const uint32_t bi, const uint32_t bj, const uint32_t r, const uint32_t s)
+{
+  const uint32_t n = r * s;
+  const uint32_t bloc = bi * r + bj;
+
+  pack->selected[pos] = 1;
+  pack->bloc_masks[bloc] |= 1U << ((pos / n - bi * r) * s + (pos % n - bj * s));
+  if (pack->bloc_masks[bloc] == BITS_MASK(n))
+    pack->open_blocs_mask &= ~(1U << bloc);
+
+  // the bloc row bi holds the blocs bi * r to bi * r + r - 1
+  if (++(pack->row_sum[bi]) >= r)
+    pack->open_blocs_mask &= ~(BITS_MASK(r) << (bi * r));
+
+  // the bloc column bj holds the blocs bj, bj + r, ..., bj + (s - 1) * r
+  if (++(pack->col_sum[bj]) >= s)
+    for (uint32_t k = 0; k < s; ++k)
+      pack->open_blocs_mask &= ~(1U << (k * r + bj));
+
+  return;
 }
 
 int8_t are_compatible_sets(const uint8_t *selected, const rel_item *items, uint32_t *row_sum, uint32_t *col_sum, const uint32_t r, const uint32_t s, const uint32_t count)
@@ -551,31 +675,6 @@ int8_t are_compatible_sets(const uint8_t *selected, const rel_item *items, uint3
   return 1;
 }
 
-uint64_t set_items_sqared_sum(rel_item *items, uint32_t n)
-{
-  uint64_t acc = 0;
-  for (uint32_t i = 0; i < n; ++i)
-    acc += ((uint64_t)items[i] * (uint64_t)items[i]);
-  return acc;
-}
-
-uint8_t is_in_hshtbl(hshtbl h, rel_item *items, uint32_t n)
-{
-  uint64_t c = hash_func(set_items_sqared_sum(items, n)) % h.capacity;
-  uint64_t i = c;
-  hshtbl_node node = h.arr[i];
-  while (node.items)
-  {
-    if (memcmp(items, node.items, n * sizeof(*items)) == 0)
-      return 1;
-
-    i = (i + 1) % h.capacity;
-    node = h.arr[i];
-  }
-
-  return 0;
-}
-
 enum SET_SEARCH_RETVALS
 {
   STOP = -1,
@@ -585,6 +684,52 @@ enum SET_SEARCH_RETVALS
   RETVAL_COUNT
 };
 
+/*
+ * hands the set in `selected` (whose sorted positions are `items`) to the callback if it was not already found
+ * returns:
+ * |> STOP if the search should stop
+ * |> NOT_FOUND if the set was already found
+ * |> found_kind otherwise
+ */
+int8_t report_set(state *pack, rel_item *items, const uint32_t n, const int8_t found_kind, perf_counter* perf, set_callback f, void *data)
+{
+  collision_shared *shared = pack->shared;
+  int8_t retval = NOT_FOUND;
+
+  if (shared != NULL)
+  {
+    pthread_mutex_lock(&shared->found_mutex);
+    if (shared->stop_flag)
+    {
+      pthread_mutex_unlock(&shared->found_mutex);
+      return STOP;
+    }
+  }
+
+  if (found_set_table_insert(pack->found, items))
+  {
+    retval = found_kind;
+    if (pack->log != NULL)
+    {
+      // flushed right away: the sets found so far survive a crash
+      fwrite(items, sizeof(*items), n, pack->log);
+      fflush(pack->log);
+    }
+    perf_counter_tick(perf);
+    if (!(*f)(pack->selected, n, data))
+      retval = STOP;
+  }
+
+  if (shared != NULL)
+  {
+    if (retval == STOP)
+      __atomic_store_n(&shared->stop_flag, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shared->found_mutex);
+  }
+
+  return retval;
+}
+
 /*
  * returns:
  * |> negative value if search should stop
@@ -599,63 +744,63 @@ int8_t check_if_set_can_be_formed_from_collision(state *pack, const uint64_t sum
   if (count <= PREFILL_CAP || count < n/2)
     return NOT_FOUND;
 
-  hshtbl *table = pack->tables + (n - count - 1);
-  uint32_t h = hash_func(pack->mu - sum) % table->capacity;
-  hshtbl_node node = table->arr[h];
-  if (node.items == NULL)
-    return NOT_FOUND;
+  const uint32_t width = n - count;
+  const uint64_t key = pack->mu - sum;
+
+  size_t candidates = 0;
+  if (pack->shared == NULL || width <= PREFILL_CAP)
+  {
+    // prefilled tables are never written to once the search started
+    candidates = gather_collision_candidates(pack, pack->tables + (width - 1), key, 0);
+  }
+  else
+  {
+    candidates = gather_collision_candidates_lf(pack, pack->shared->lf_tables + (width - 1), key, 0);
+  }
 
-  uint8_t retval = NOT_FOUND;
+  int8_t retval = NOT_FOUND;
   // found a least match if there are no repeated entries and the union respects the sum conditions
-  do
+  for (size_t c = 0; c < candidates; ++c)
   {
-    if (node.sum + sum != pack->mu)
-      continue;
+    const rel_item *items = pack->candidates + c * width;
 
     // reset the row/col sum arrays
     memcpy(pack->row_sum_copy, pack->row_sum, s * sizeof(uint32_t));
     memcpy(pack->col_sum_copy, pack->col_sum, r * sizeof(uint32_t));
 
-    if (!are_compatible_sets(pack->selected, node.items, pack->row_sum_copy, pack->col_sum_copy, r, s, count))
+    if (!are_compatible_sets(pack->selected, items, pack->row_sum_copy, pack->col_sum_copy, r, s, count))
       continue;
 
     // add entries from the match
-    for (uint32_t i = 0; i < n - count; ++i)
+    for (uint32_t i = 0; i < width; ++i)
     {
-      uint32_t pos = node.items[i];
+      uint32_t pos = items[i];
       pack->selected[pos] = 1;
     }
 
-    memset(pack->items2, 0, n * sizeof(*node.items));
-    for (uint32_t k = 0, idx = 0; k < count && idx < n * n; ++idx)
+    // sorted positions of the whole set, the same key as for sets found by guessing
+    for (uint32_t k = 0, idx = 0; k < n && idx < n * n; ++idx)
     {
       if (pack->selected[idx])
         pack->items2[k++] = (rel_item)idx;
     }
-    for (uint32_t k = count; k < n; ++k)
-      pack->items2[k] = node.items[k - count];
 
-    if (!is_in_hshtbl(pack->found, pack->items2, n))
+    const int8_t ret = report_set(pack, pack->items2, n, COLLISION_FOUND, perf, f, data);
+    if (ret == STOP)
     {
-      retval = COLLISION_FOUND;
-      perf_counter_tick(perf);
-      if (!(*f)(pack->selected, n, data))
-      {
-        retval = STOP;
-        goto ret;
-      }
-      hshtbl_insert(&pack->found, pack->items2, pack->selected, n, set_items_sqared_sum(pack->items2, n), n);
+      retval = STOP;
+      goto ret;
     }
+    if (ret > 0)
+      retval = ret;
 
-    // cont:
     // remove entries from the match
-    for (uint32_t i = 0; i < n - count; ++i)
+    for (uint32_t i = 0; i < width; ++i)
     {
-      uint32_t pos = node.items[i];
+      uint32_t pos = items[i];
       pack->selected[pos] = 0;
     }
-
-  } while ((node = table->arr[h = (h + 1) % table->capacity]).items != NULL && node.sum == sum);
+  }
 
 ret:
   return retval;
@@ -673,7 +818,7 @@ uint8_t set_has_magic_sum(const uint8_t *selected, const pow_m_sqr M)
       if (GET_AS_MAT(selected, i, j, M.n))
       {
         // printf("%"PRIu64"^%u + ", M_SQR_GET_AS_MAT(M, i, j), M.d);
-        acc += ui_pow_ui(M_SQR_GET_AS_MAT(M, i, j), M.d);
+        acc += M_SQR_GET_POW_AS_MAT(M, i, j);
       }
 
   //printf(" = %"PRIu64" != %"PRIu64"\n", acc, mu);
@@ -713,7 +858,7 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
   while (count < n)
   {
 #if 1
-    int32_t selected_bloc = select_open_bloc(pack->selected, pack->col_sum, pack->row_sum, pack->open_blocs, r, s);
+    int32_t selected_bloc = select_open_bloc(pack);
     if (selected_bloc < 0)
       // no valid blocs: abort with current search status (either NOT_FOUND or COLLISION_FOUND)
       return retval;
@@ -721,11 +866,9 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
     uint32_t selected_bi = selected_bloc / r;
     uint32_t selected_bj = selected_bloc % r;
 
-    ++(pack->row_sum[selected_bi]);
-    ++(pack->col_sum[selected_bj]);
-
     // get one entry from the list we selected
-    rel_item selected_entry = select_open_entry_in_bloc(pack->selected, pack->open_entries_in_bloc, selected_bi, selected_bj, r, s);
+    rel_item selected_entry = select_open_entry_in_bloc(pack, selected_bi, selected_bj, r, s);
+    select_entry(pack, selected_entry, selected_bi, selected_bj, r, s);
 #else
 
     uint32_t selected_entry = 1;
@@ -738,12 +881,12 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
       fprintf(stderr, "What ??? found.count = %"PRIu64"\n", pack->found->count);
 
     // printf("%u: %"PRIu64"\n", selected_entry, M_SQR_GET_AS_VEC(M, selected_entry));
+    pack->selected[selected_entry] = 1;
 #endif
 
-    pack->selected[selected_entry] = 1;
     pack->items[count++] = selected_entry;
 
-    sum += ui_pow_ui(M_SQR_GET_AS_VEC(M, selected_entry), M.d);
+    sum += M_SQR_GET_POW_AS_VEC(M, selected_entry);
 
     // printf("%u\n", count);
     if (count >= n)
@@ -758,7 +901,7 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
      * nor insert the ones which are already saved in PREFILL_CAP
      */
     if (PREFILL_CAP < count && count <= n/2)
-      hshtbl_insert(&(pack->tables[count - 1]), pack->items, pack->selected, count, sum, n); // -1 because pack->tables is zero indexed
+      state_insert_partial_set(pack, count, sum, n);
 
     int8_t ret = check_if_set_can_be_formed_from_collision(pack, sum, r, s, count, perf, f, data);
     if (ret > 0)
@@ -784,14 +927,9 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
         pack->items[k++] = idx;
     }
 
-    if (!is_in_hshtbl(pack->found, pack->items, n))
-    {
-      // sum was magic
-      hshtbl_insert(&pack->found, pack->items, pack->selected, n, set_items_sqared_sum(pack->items, n), n);
-      perf_counter_tick(perf);
-      if (!(*f)(pack->selected, n, data))
-        return STOP;
-    }
+    // sum was magic
+    if (report_set(pack, pack->items, n, GUESS_FOUND, perf, f, data) == STOP)
+      return STOP;
     return GUESS_FOUND;
   }
 
@@ -800,19 +938,242 @@ int8_t generate_random_set_with_magic_sum(state *pack, const pow_m_sqr M, const
   return retval;
 }
 
-#define MAX_ALLOWED_TRIES (100 * 1024 * 1024)
+// ----------- persistence of the collision method ---------------
 
-void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, perf_counter* perf, set_callback f, void *data)
-{
-  const size_t n = r * s;
+/*
+ * Format of the log of the found sets:
+ * [   n   ][   mu   ][  set  ][  set  ]...
+ * uint32_t uint64_t  n rel_items each, the sorted positions given to report_set
+ * the sets are appended as they are found, a set cut short by a crash is dropped at the next start
+ */
 
-  state pack = {0};
-  init_state(&pack, &M, r, s);
-  pack.mu = pow_m_sqr_sum_row(M, 0); // magic sum
+/*
+ * passes the sets of the log to f as if they were just found, then opens it for appending
+ * returns NULL if log_file is NULL, stop is set if f asked to stop while reading the log back
+ */
+static FILE *open_sets_log(const char *log_file, state *pack, const uint32_t n, perf_counter* perf, set_callback f, void *data, uint8_t *stop)
+{
+  *stop = 0;
+  if (log_file == NULL)
+    return NULL;
 
-  uint64_t tries = 0;
-  size_t *prev_counts = calloc(n/2, sizeof(size_t));
-  if (prev_counts == NULL)
+  size_t replayed = 0;
+  FILE *log = fopen(log_file, "r+b");
+  if (log != NULL)
+  {
+    uint32_t log_n = 0;
+    uint64_t log_mu = 0;
+    const uint8_t ok = fread(&log_n, sizeof(log_n), 1, log) == 1 && fread(&log_mu, sizeof(log_mu), 1, log) == 1
+                    && log_n == n && log_mu == pack->mu;
+    if (!ok)
+    {
+      fprintf(stderr, "[WARNING] Ignoring %s: it does not belong to this square\n", log_file);
+      fclose(log);
+      log = NULL;
+    }
+    else
+    {
+      long end = ftell(log);
+      while (fread(pack->items2, sizeof(rel_item), n, log) == n)
+      {
+        end = ftell(log);
+        if (*stop)
+          continue;
+
+        memset(pack->selected, 0, n * n * sizeof(*pack->selected));
+        for (uint32_t k = 0; k < n; ++k)
+          pack->selected[pack->items2[k]] = 1;
+
+        if (found_set_table_insert(pack->found, pack->items2))
+        {
+          ++replayed;
+          perf_counter_tick(perf);
+          if (!(*f)(pack->selected, n, data))
+            *stop = 1;
+        }
+      }
+
+      // the next sets overwrite the one cut short, if any
+      fseek(log, end, SEEK_SET);
+    }
+  }
+
+  if (log == NULL)
+  {
+    log = fopen(log_file, "wb");
+    if (log == NULL)
+    {
+      fprintf(stderr, "[ERROR] Could not open file %s: %s\n", log_file, strerror(errno));
+      exit(1);
+    }
+    fwrite(&n, sizeof(n), 1, log);
+    fwrite(&pack->mu, sizeof(pack->mu), 1, log);
+    fflush(log);
+  }
+
+  if (replayed > 0)
+  {
+#ifndef __NO_GUI__
+    printw("Read back %zu sets from %s\n", replayed, log_file);
+#else
+    printf("Read back %zu sets from %s\n", replayed, log_file);
+#endif
+  }
+
+  return log;
+}
+
+/*
+ * Format of the snapshot of the tables:
+ * [   n   ][   mu   ] then for every table of partial sets of k + 1 entries, PREFILL_CAP <= k < n/2:
+ * uint32_t uint64_t   [ count  ] and count times [  sum   ][  items  ]
+ *                     uint64_t                   uint64_t  k + 1 rel_items
+ * the prefilled tables are not saved, they are rebuilt from M
+ * exactly one of tables and lf_tables is NULL, the tables must not be written to while saving
+ */
+static void save_sets_snapshot(const char *snapshot_file, const uint32_t n, const uint64_t mu, const hshtbl *tables, const lf_hshtbl *lf_tables)
+{
+  // write then rename, so that an interrupted write never loses the previous snapshot
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", snapshot_file);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "[ERROR] Could not open file %s: %s\n", tmp, strerror(errno));
+    return;
+  }
+  fwrite(&n, sizeof(n), 1, f);
+  fwrite(&mu, sizeof(mu), 1, f);
+
+  for (uint32_t k = PREFILL_CAP; k < n/2; ++k)
+  {
+    uint64_t count = 0;
+    if (tables != NULL)
+    {
+      const hshtbl *table = tables + k;
+      count = table->count;
+      fwrite(&count, sizeof(count), 1, f);
+      for (size_t h = 0; h < table->capacity; ++h)
+        if (table->arr[h].item)
+        {
+          fwrite(&table->arr[h].sum, sizeof(table->arr[h].sum), 1, f);
+          fwrite(HSHTBL_NODE_ITEMS(table, table->arr[h]), sizeof(rel_item), table->width, f);
+        }
+    }
+    else
+    {
+      const lf_hshtbl *table = lf_tables + k;
+      for (size_t h = 0; h < table->capacity; ++h)
+        count += table->arr[h].state == LF_HSHTBL_READY;
+      fwrite(&count, sizeof(count), 1, f);
+      for (size_t h = 0; h < table->capacity; ++h)
+        if (table->arr[h].state == LF_HSHTBL_READY)
+        {
+          fwrite(&table->arr[h].sum, sizeof(table->arr[h].sum), 1, f);
+          fwrite(LF_HSHTBL_SLOT_ITEMS(table, h), sizeof(rel_item), table->width, f);
+        }
+    }
+  }
+  fclose(f);
+
+  if (rename(tmp, snapshot_file) != 0)
+    fprintf(stderr, "[ERROR] Could not rename %s: %s\n", tmp, strerror(errno));
+
+  return;
+}
+
+/*
+ * inserts the partial sets of the snapshot into tables or lf_tables, see save_sets_snapshot
+ * leaves them untouched if there is no snapshot of this square
+ */
+static void load_sets_snapshot(const char *snapshot_file, state *pack, const uint32_t n, hshtbl *tables, lf_hshtbl *lf_tables)
+{
+  FILE *f = fopen(snapshot_file, "rb");
+  if (f == NULL)
+    return;
+
+  uint32_t snapshot_n = 0;
+  uint64_t snapshot_mu = 0;
+  if (fread(&snapshot_n, sizeof(snapshot_n), 1, f) != 1 || fread(&snapshot_mu, sizeof(snapshot_mu), 1, f) != 1
+      || snapshot_n != n || snapshot_mu != pack->mu)
+  {
+    fprintf(stderr, "[WARNING] Ignoring snapshot %s: it does not belong to this square\n", snapshot_file);
+    fclose(f);
+    return;
+  }
+
+  memset(pack->selected, 0, n * n * sizeof(*pack->selected));
+
+  size_t loaded = 0;
+  for (uint32_t k = PREFILL_CAP; k < n/2; ++k)
+  {
+    const uint32_t width = k + 1;
+    uint64_t count = 0;
+    if (fread(&count, sizeof(count), 1, f) != 1)
+      break;
+
+    for (uint64_t c = 0; c < count; ++c)
+    {
+      uint64_t sum = 0;
+      if (fread(&sum, sizeof(sum), 1, f) != 1 || fread(pack->items, sizeof(rel_item), width, f) != width)
+      {
+        fprintf(stderr, "[WARNING] Snapshot %s is cut short, only the partial sets before the cut are used\n", snapshot_file);
+        goto ret;
+      }
+
+      // the tables tell duplicates apart through selected
+      for (uint32_t i = 0; i < width; ++i)
+        pack->selected[pack->items[i]] = 1;
+      if (tables != NULL)
+        hshtbl_insert(tables + k, pack->items, pack->selected, width, sum, n);
+      else
+        lf_hshtbl_insert(lf_tables + k, pack->items, pack->selected, width, sum, n);
+      for (uint32_t i = 0; i < width; ++i)
+        pack->selected[pack->items[i]] = 0;
+      ++loaded;
+    }
+  }
+
+ret:
+  fclose(f);
+
+#ifndef __NO_GUI__
+  printw("Read back %zu partial sets from %s\n", loaded, snapshot_file);
+#else
+  printf("Read back %zu partial sets from %s\n", loaded, snapshot_file);
+#endif
+
+  return;
+}
+
+#define MAX_ALLOWED_TRIES (100 * 1024 * 1024)
+
+/*
+ * if log_file is not NULL, the sets it holds are given to f first and the ones found are appended to it
+ * if snapshot_file is not NULL, the tables start from it if it exists and are saved to it every SETS_SNAPSHOT_PERIOD seconds
+ * if prefill_dir is not NULL, the prefilled tables are shared through it with the other runs on M
+ */
+void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, const char *log_file, const char *snapshot_file, const char *prefill_dir, perf_counter* perf, set_callback f, void *data)
+{
+  const size_t n = r * s;
+
+  state pack = {0};
+  init_state(&pack, &M, r, s, requiered_sets, prefill_dir);
+  pack.mu = pow_m_sqr_sum_row(M, 0); // magic sum
+
+  if (snapshot_file != NULL)
+    load_sets_snapshot(snapshot_file, &pack, n, pack.tables, NULL);
+
+  uint8_t stop = 0;
+  pack.log = open_sets_log(log_file, &pack, n, perf, f, data, &stop);
+
+  timer since_snapshot;
+  timer_start(&since_snapshot);
+
+  uint64_t tries = 0;
+  size_t *prev_counts = calloc(n/2, sizeof(size_t));
+  if (prev_counts == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
@@ -820,8 +1181,8 @@ void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s,
 
   uint16_t refresh_frames = 0;
 
-  int8_t ret;
-  do
+  int8_t ret = NOT_FOUND;
+  while (!stop && ret >= 0)
   {
     reset_state(&pack, r, s);
     ret = generate_random_set_with_magic_sum(&pack, M, r, s, perf, f, data);
@@ -856,6 +1217,12 @@ void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s,
 
     if (refresh_frames == 0)
     {
+      if (snapshot_file != NULL && timer_stop(&since_snapshot) >= SETS_SNAPSHOT_PERIOD)
+      {
+        save_sets_snapshot(snapshot_file, n, pack.mu, pack.tables, NULL);
+        timer_start(&since_snapshot);
+      }
+
 #ifndef __NO_GUI__
       clear();
       move(0, 0);
@@ -873,9 +1240,514 @@ void find_sets_collision_method(pow_m_sqr M, const uint32_t r, const uint32_t s,
 #endif
     }
     ++refresh_frames;
-  } while (ret >= 0);
+  }
 
+  if (pack.log != NULL)
+    fclose(pack.log);
   free_state(pack, r, s);
   free(prev_counts);
   return;
 }
+
+/*
+ * number of sets drawn by a worker before it lets the main thread reset the tables
+ */
+#define TRIES_PER_LOCK (256)
+
+typedef struct
+{
+  pthread_t id;
+  collision_shared *shared;
+  pow_m_sqr *M;
+  uint32_t r, s;
+  perf_counter *perf;
+  set_callback f;
+  void *data;
+  rng rng;
+  _Atomic uint64_t tries; // draws since the last found set, read by the main thread without locking
+} collision_worker_data;
+
+void *collision_worker(void *arg)
+{
+  collision_worker_data *w = (collision_worker_data*)arg;
+  collision_shared *shared = w->shared;
+
+  state pack = {0};
+  init_state_buffers(&pack, w->M, w->r, w->s);
+  pack.shared = shared;
+  pack.rng = w->rng;
+  pack.found = &shared->found;
+  pack.log = shared->log;
+  pack.tables = shared->tables;
+  pack.mu = pow_m_sqr_sum_row(*w->M, 0); // magic sum
+  pack.regime = REGIME_FILL;
+
+  while (!__atomic_load_n(&shared->stop_flag, __ATOMIC_RELAXED))
+  {
+    // let the main thread grab the write lock
+    while (__atomic_load_n(&shared->reset_pending, __ATOMIC_ACQUIRE))
+      sched_yield();
+
+    pthread_rwlock_rdlock(&shared->reset_lock);
+    for (uint32_t i = 0; i < TRIES_PER_LOCK; ++i)
+    {
+      reset_state(&pack, w->r, w->s);
+      int8_t ret = generate_random_set_with_magic_sum(&pack, *w->M, w->r, w->s, w->perf, w->f, w->data);
+      if (ret < 0)
+        break;
+
+      const uint64_t tries = __atomic_load_n(&w->tries, __ATOMIC_RELAXED);
+      __atomic_store_n(&w->tries, ret > 0 ? 0 : tries + 1, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&shared->reset_lock);
+  }
+
+  free_state_buffers(pack);
+  return NULL;
+}
+
+/*
+ * same as find_sets_collision_method but the sets are drawn by `thread_count` workers sharing the same tables
+ * the calls to f are serialized
+ */
+void find_sets_collision_method_mt(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, size_t thread_count, const char *log_file, const char *snapshot_file, const char *prefill_dir, perf_counter* perf, set_callback f, void *data)
+{
+  const size_t n = r * s;
+  const uint64_t mu = pow_m_sqr_sum_row(M, 0); // magic sum
+
+  if (thread_count == 0)
+    thread_count = 1;
+
+  collision_shared shared = {0};
+  init_found_set_table(&shared.found, n, requiered_sets);
+  pthread_mutex_init(&shared.found_mutex, NULL);
+  pthread_rwlock_init(&shared.reset_lock, NULL);
+
+  // prefilled tables are shared read only, the bigger partial sets go into lock-free tables
+  shared.tables = init_hshtbls(n);
+  prefill_or_map_hshtbls(shared.tables, M, n, thread_count, prefill_dir, &shared.prefill_mapping);
+
+  shared.lf_tables = calloc(n/2, sizeof(lf_hshtbl));
+  collision_worker_data *workers = calloc(thread_count, sizeof(collision_worker_data));
+  size_t *prev_counts = calloc(n/2, sizeof(size_t));
+  if (shared.lf_tables == NULL || workers == NULL || prev_counts == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+  for (uint32_t k = PREFILL_CAP; k < n/2; ++k)
+    init_lf_hshtbl(shared.lf_tables + k, k + 1, lf_hshtbl_capacity(n, k + 1));
+
+  // the snapshot and the log are read back before the workers start, with buffers of their own
+  state pack = {0};
+  init_state_buffers(&pack, &M, r, s);
+  pack.found = &shared.found;
+  pack.mu = mu;
+  if (snapshot_file != NULL)
+    load_sets_snapshot(snapshot_file, &pack, n, NULL, shared.lf_tables);
+  shared.log = open_sets_log(log_file, &pack, n, perf, f, data, &shared.stop_flag);
+  free_state_buffers(pack);
+
+  timer since_snapshot;
+  timer_start(&since_snapshot);
+
+  for (size_t t = 0; t < thread_count; ++t)
+  {
+    workers[t] = (collision_worker_data) {
+      .shared = &shared, .M = &M, .r = r, .s = s, .perf = perf, .f = f, .data = data, .tries = 0,
+      // split from the main thread so that the streams do not depend on the scheduling
+      .rng = rng_split_global()
+    };
+    pthread_create(&workers[t].id, NULL, collision_worker, workers + t);
+  }
+
+  uint64_t tries_at_last_change = 0;
+  const struct timespec frame = {.tv_sec = 0, .tv_nsec = 200 * 1000 * 1000};
+  while (!__atomic_load_n(&shared.stop_flag, __ATOMIC_RELAXED))
+  {
+    nanosleep(&frame, NULL);
+
+    uint64_t tries = 0;
+    for (size_t t = 0; t < thread_count; ++t)
+      tries += __atomic_load_n(&workers[t].tries, __ATOMIC_RELAXED);
+
+    uint8_t changed = 0;
+    uint64_t tables_tot_count = 0, tables_tot_capa = 0;
+    for (uint32_t k = 0; k < n/2; ++k)
+    {
+      size_t c = 0, capa = 0;
+      if (k < PREFILL_CAP)
+      {
+        c = shared.tables[k].count;
+        capa = shared.tables[k].capacity;
+      }
+      else
+      {
+        c = lf_hshtbl_count(shared.lf_tables + k);
+        capa = shared.lf_tables[k].capacity;
+      }
+
+      if (c > prev_counts[k])
+        changed = 1;
+      prev_counts[k] = c;
+      tables_tot_count += c;
+      tables_tot_capa += capa;
+    }
+
+    if (changed)
+      tries_at_last_change = tries;
+    if (tries < tries_at_last_change)
+      // some worker found a set
+      tries_at_last_change = 0;
+
+    if (tries - tries_at_last_change > MAX_ALLOWED_TRIES)
+    {
+      __atomic_store_n(&shared.reset_pending, 1, __ATOMIC_RELEASE);
+      pthread_rwlock_wrlock(&shared.reset_lock);
+      for (uint32_t k = PREFILL_CAP; k < n/2; ++k)
+        empty_lf_hshtbl(shared.lf_tables + k);
+      for (size_t t = 0; t < thread_count; ++t)
+        __atomic_store_n(&workers[t].tries, 0, __ATOMIC_RELAXED);
+      tries_at_last_change = 0;
+      pthread_rwlock_unlock(&shared.reset_lock);
+      __atomic_store_n(&shared.reset_pending, 0, __ATOMIC_RELEASE);
+    }
+
+    if (snapshot_file != NULL && timer_stop(&since_snapshot) >= SETS_SNAPSHOT_PERIOD)
+    {
+      // the lock-free tables must not be written to while they are saved
+      __atomic_store_n(&shared.reset_pending, 1, __ATOMIC_RELEASE);
+      pthread_rwlock_wrlock(&shared.reset_lock);
+      save_sets_snapshot(snapshot_file, n, mu, NULL, shared.lf_tables);
+      pthread_rwlock_unlock(&shared.reset_lock);
+      __atomic_store_n(&shared.reset_pending, 0, __ATOMIC_RELEASE);
+      timer_start(&since_snapshot);
+    }
+
+    pthread_mutex_lock(&shared.found_mutex);
+#ifndef __NO_GUI__
+    clear();
+    move(0, 0);
+    for (uint32_t i = 0; i < n/2; ++i)
+      printw("%7"PRIu64", ", prev_counts[i]);
+    addch('\n');
+    printw("tot: %"PRIu64"/ %"PRIu64": %.2f%%\n", tables_tot_count, tables_tot_capa, 100.0 * (double) tables_tot_count / (double) tables_tot_capa);
+
+    printw("threads, tries, found: %zu, %7"PRIu64", %zu/%zu\n", thread_count, tries, perf->counter, requiered_sets);
+    print_perfw(perf, "sets");
+    refresh();
+#else
+    putchar('\r');
+    printf("tot: %"PRIu64"/ %"PRIu64": %.2f%%", tables_tot_count, tables_tot_capa, 100.0 * (double) tables_tot_count / (double) tables_tot_capa);
+    fflush(stdout);
+#endif
+    pthread_mutex_unlock(&shared.found_mutex);
+  }
+
+  for (size_t t = 0; t < thread_count; ++t)
+    pthread_join(workers[t].id, NULL);
+
+  if (shared.log != NULL)
+    fclose(shared.log);
+  for (uint32_t k = PREFILL_CAP; k < n/2; ++k)
+    free_lf_hshtbl(shared.lf_tables + k);
+  free(shared.lf_tables);
+  free_hshtbls(shared.tables, n);
+  unmap_hshtbls(&shared.prefill_mapping);
+  free_found_set_table(&shared.found);
+  pthread_mutex_destroy(&shared.found_mutex);
+  pthread_rwlock_destroy(&shared.reset_lock);
+  free(workers);
+  free(prev_counts);
+  return;
+}
+
+// ----------- batched join ---------------
+
+typedef struct
+{
+  uint64_t sum;
+  uint32_t index; // of the partial set in the items of its batch
+} join_entry;
+
+/*
+ * partial sets of width entries, drawn as in generate_random_set_with_magic_sum, whose sums are below mu
+ */
+typedef struct
+{
+  uint32_t width;
+  size_t count;
+  join_entry *entries, *scratch; // SETS_JOIN_BATCH each, scratch is for the radix sort
+  rel_item *items;               // count partial sets of width rel_items
+} join_batch;
+
+static void init_join_batch(join_batch *batch, const uint32_t width)
+{
+  batch->width = width;
+  batch->count = 0;
+  batch->entries = calloc(SETS_JOIN_BATCH, sizeof(join_entry));
+  batch->scratch = calloc(SETS_JOIN_BATCH, sizeof(join_entry));
+  batch->items = calloc((size_t)SETS_JOIN_BATCH * width, sizeof(rel_item));
+  if (batch->entries == NULL || batch->scratch == NULL || batch->items == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  return;
+}
+
+static void free_join_batch(join_batch *batch)
+{
+  free(batch->entries);
+  free(batch->scratch);
+  free(batch->items);
+
+  return;
+}
+
+/*
+ * draws partial sets until the batch is full
+ */
+static void fill_join_batch(state *pack, join_batch *batch, const uint32_t r, const uint32_t s)
+{
+  const pow_m_sqr M = *pack->M;
+  batch->count = 0;
+
+  while (batch->count < SETS_JOIN_BATCH)
+  {
+    reset_state(pack, r, s);
+
+    uint64_t sum = 0;
+    uint32_t count = 0;
+    while (count < batch->width && sum < pack->mu)
+    {
+      const int32_t bloc = select_open_bloc(pack);
+      if (bloc < 0)
+        break;
+
+      const uint32_t bi = bloc / r;
+      const uint32_t bj = bloc % r;
+      const rel_item entry = select_open_entry_in_bloc(pack, bi, bj, r, s);
+      select_entry(pack, entry, bi, bj, r, s);
+      pack->items[count++] = entry;
+      sum += M_SQR_GET_POW_AS_VEC(M, entry);
+    }
+    if (count < batch->width || sum >= pack->mu)
+      continue;
+
+    memcpy(batch->items + batch->count * batch->width, pack->items, batch->width * sizeof(rel_item));
+    batch->entries[batch->count] = (join_entry) { .sum = sum, .index = batch->count };
+    ++batch->count;
+  }
+
+  return;
+}
+
+/*
+ * LSD radix sort of the entries by sum, a byte at a time, the sums being below 2^bits
+ */
+static void sort_join_batch(join_batch *batch, const uint32_t bits)
+{
+  join_entry *from = batch->entries, *to = batch->scratch;
+
+  for (uint32_t shift = 0; shift < bits; shift += 8)
+  {
+    size_t offsets[256] = {0};
+    for (size_t i = 0; i < batch->count; ++i)
+      ++offsets[(from[i].sum >> shift) & 0xFF];
+
+    size_t acc = 0;
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+      const size_t c = offsets[b];
+      offsets[b] = acc;
+      acc += c;
+    }
+
+    for (size_t i = 0; i < batch->count; ++i)
+      to[offsets[(from[i].sum >> shift) & 0xFF]++] = from[i];
+
+    join_entry *tmp = from;
+    from = to;
+    to = tmp;
+  }
+
+  batch->entries = from;
+  batch->scratch = to;
+
+  return;
+}
+
+/*
+ * selects the partial set of items in pack, as the draws would have
+ */
+static void join_select(state *pack, const rel_item *items, const uint32_t width, const uint32_t r, const uint32_t s)
+{
+  const uint32_t n = r * s;
+
+  memset(pack->selected, 0, n * n * sizeof(*pack->selected));
+  memset(pack->row_sum, 0, s * sizeof(*pack->row_sum));
+  memset(pack->col_sum, 0, r * sizeof(*pack->col_sum));
+  for (uint32_t i = 0; i < width; ++i)
+  {
+    pack->selected[items[i]] = 1;
+    ++pack->row_sum[items[i] / n / r];
+    ++pack->col_sum[items[i] % n / s];
+  }
+
+  return;
+}
+
+/*
+ * reports the union of the partial set in pack and the one of items, if they form a set
+ */
+static int8_t join_report(state *pack, const rel_item *items, const uint32_t count, const uint32_t r, const uint32_t s, perf_counter* perf, set_callback f, void *data)
+{
+  const uint32_t n = r * s;
+  const uint32_t width = n - count;
+
+  memcpy(pack->row_sum_copy, pack->row_sum, s * sizeof(uint32_t));
+  memcpy(pack->col_sum_copy, pack->col_sum, r * sizeof(uint32_t));
+  if (!are_compatible_sets(pack->selected, items, pack->row_sum_copy, pack->col_sum_copy, r, s, count))
+    return NOT_FOUND;
+
+  for (uint32_t i = 0; i < width; ++i)
+    pack->selected[items[i]] = 1;
+
+  for (uint32_t k = 0, idx = 0; k < n && idx < n * n; ++idx)
+    if (pack->selected[idx])
+      pack->items2[k++] = (rel_item)idx;
+
+  const int8_t ret = report_set(pack, pack->items2, n, COLLISION_FOUND, perf, f, data);
+
+  for (uint32_t i = 0; i < width; ++i)
+    pack->selected[items[i]] = 0;
+
+  return ret;
+}
+
+/*
+ * walks a up and b down, both sorted, to find every pair of partial sets whose sums add up to mu
+ * if a and b are the same batch, each pair is only tried once
+ * returns STOP if the search should stop, the number of pairs whose sums matched otherwise
+ */
+static int64_t join_batches(state *pack, const join_batch *a, const join_batch *b, const uint32_t r, const uint32_t s, perf_counter* perf, set_callback f, void *data)
+{
+  const uint8_t same = a == b;
+  int64_t matches = 0;
+
+  size_t i = 0, j = b->count;
+  while (same ? i + 1 < j : (i < a->count && j > 0))
+  {
+    const uint64_t sum = a->entries[i].sum + b->entries[j - 1].sum;
+    if (sum < pack->mu)
+    {
+      ++i;
+      continue;
+    }
+    if (sum > pack->mu)
+    {
+      --j;
+      continue;
+    }
+
+    // every pair of the runs of equal sums on both sides matches
+    size_t i_end = i, j_begin = j;
+    while (i_end < a->count && a->entries[i_end].sum == a->entries[i].sum)
+      ++i_end;
+    while (j_begin > 0 && b->entries[j_begin - 1].sum == b->entries[j - 1].sum)
+      --j_begin;
+
+    for (size_t ia = i; ia < i_end; ++ia)
+    {
+      join_select(pack, a->items + a->entries[ia].index * a->width, a->width, r, s);
+      // within a single run, only the pairs after ia
+      for (size_t jb = (same && j_begin <= ia) ? ia + 1 : j_begin; jb < j; ++jb)
+      {
+        ++matches;
+        if (join_report(pack, b->items + b->entries[jb].index * b->width, a->width, r, s, perf, f, data) == STOP)
+          return STOP;
+      }
+    }
+
+    i = i_end;
+    j = j_begin;
+  }
+
+  return matches;
+}
+
+/*
+ * same sets as the collision method, but the partial sets are drawn by batches of SETS_JOIN_BATCH, sorted by sum
+ * and joined by a linear merge: the tables are streamed through instead of probed at random
+ * a batch holds partial sets of n/2 entries, an other one those of n - n/2 entries if n is odd
+ * if log_file is not NULL, the sets it holds are given to f first and the ones found are appended to it
+ */
+void find_sets_join_method(pow_m_sqr M, const uint32_t r, const uint32_t s, size_t requiered_sets, const char *log_file, perf_counter* perf, set_callback f, void *data)
+{
+  const uint32_t n = r * s;
+
+  state pack = {0};
+  init_state_buffers(&pack, &M, r, s);
+  pack.rng = rng_split_global();
+  pack.mu = pow_m_sqr_sum_row(M, 0); // magic sum
+  pack.found = calloc(1, sizeof(found_set_table));
+  if (pack.found == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+  init_found_set_table(pack.found, n, requiered_sets);
+
+  uint8_t stop = 0;
+  pack.log = open_sets_log(log_file, &pack, n, perf, f, data, &stop);
+
+  const uint32_t bits = 64 - __builtin_clzll(pack.mu);
+  join_batch batches[2];
+  init_join_batch(batches + 0, n / 2);
+  if (n % 2)
+    init_join_batch(batches + 1, n - n / 2);
+  join_batch *other = (n % 2) ? batches + 1 : batches + 0;
+
+  uint64_t batch_count = 0, matches = 0;
+  while (!stop)
+  {
+    fill_join_batch(&pack, batches + 0, r, s);
+    sort_join_batch(batches + 0, bits);
+    if (other != batches + 0)
+    {
+      fill_join_batch(&pack, other, r, s);
+      sort_join_batch(other, bits);
+    }
+
+    const int64_t ret = join_batches(&pack, batches + 0, other, r, s, perf, f, data);
+    if (ret == STOP)
+      break;
+    matches += ret;
+    ++batch_count;
+
+#ifndef __NO_GUI__
+    clear();
+    move(0, 0);
+    printw("batches: %"PRIu64" of %d partial sets, sums matched: %"PRIu64"\n", batch_count, SETS_JOIN_BATCH, matches);
+    printw("found: %"PRIu64"/%zu\n", perf->counter, requiered_sets);
+    print_perfw(perf, "sets");
+    refresh();
+#else
+    putchar('\r');
+    printf("batches: %"PRIu64", sums matched: %"PRIu64", found: %"PRIu64"/%zu", batch_count, matches, perf->counter, requiered_sets);
+    fflush(stdout);
+#endif
+  }
+
+  if (pack.log != NULL)
+    fclose(pack.log);
+  free_join_batch(batches + 0);
+  if (n % 2)
+    free_join_batch(batches + 1);
+  free_state_buffers(pack);
+  free_found_set_table(pack.found);
+  free(pack.found);
+  return;
+}
@@ -0,0 +1,375 @@
+/*
+ * exhaustive set search by meet-in-the-middle
+ *
+ * the s bloc rows are split in two halves: the top one holds the s/2 first bloc rows, the bottom one the others
+ * a set is exactly a half-selection of each half, where:
+ *   - each bloc row of the half holds r entries
+ *   - the counts per bloc column of both halves add up to s
+ *   - the sums of the powers of both halves add up to mu
+ * every top half-selection is stored, sorted by (column counts, sum)
+ * the bottom half-selections are streamed in a fixed order and joined against the top ones by binary search
+ *
+ * since the bottom ones always come in the same order, the index of the next one to join and the number of its
+ * matches already given are enough to resume
+ */
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "find_sets.h"
+#include "pow_m_sqr.h"
+
+#include "perf_counter.h"
+
+#include <ncurses.h>
+
+// the bottom half-selections are joined in between two checkpoints
+#define MITM_CHECKPOINT_INTERVAL (1 << 16)
+
+/*
+ * column counts of a half-selection, 4 bits per bloc column: there are r <= 8 of them and they are at most s <= 15
+ */
+typedef uint32_t col_signature;
+#define SIG_SHIFT(bj) (4 * (bj))
+
+typedef struct
+{
+  uint64_t sum;
+  col_signature sig;
+  uint32_t index; // in the items of the top half
+} mitm_entry;
+
+typedef struct
+{
+  const pow_m_sqr *M;
+  uint32_t r, s, n;
+  uint64_t mu;
+  uint64_t tag;   // FNV-1a of pows, a checkpoint is only resumed on the square it was saved for
+  uint64_t *pows; // n * n, the d-th power of every entry, with the rows and cols permutations applied
+
+  // current half-selection
+  uint8_t *selected;
+  uint32_t *col_count;
+  rel_item *items;
+  uint32_t count;
+
+  // top half
+  mitm_entry *top;
+  rel_item *top_items;
+  size_t top_count, top_capacity;
+  uint32_t top_width; // number of entries of a top half-selection
+
+  // bottom half
+  uint64_t bottom_index; // number of bottom half-selections enumerated so far
+  uint64_t resume_from;  // the bottom half-selections before this one were already joined
+  uint64_t resume_match; // number of matches of the bottom half-selection resume_from already given
+  const char *checkpoint_file;
+
+  perf_counter *perf;
+  set_callback f;
+  void *data;
+} mitm_data;
+
+typedef uint8_t (*half_callback)(mitm_data *d, uint64_t sum);
+
+static col_signature current_signature(const mitm_data *d)
+{
+  col_signature sig = 0;
+  for (uint32_t bj = 0; bj < d->r; ++bj)
+    sig |= d->col_count[bj] << SIG_SHIFT(bj);
+  return sig;
+}
+
+/*
+ * signature a half-selection must have to complete `sig` into a set
+ */
+static col_signature complement_signature(const mitm_data *d, col_signature sig)
+{
+  col_signature ret = 0;
+  for (uint32_t bj = 0; bj < d->r; ++bj)
+    ret |= (d->s - ((sig >> SIG_SHIFT(bj)) & 0xF)) << SIG_SHIFT(bj);
+  return ret;
+}
+
+/*
+ * enumerates the half-selections of the bloc rows [bi, last_bi), in a fixed order
+ * the r entries of a bloc row are picked in increasing order among its r * n cells
+ * returns zero if the enumeration should stop
+ */
+static uint8_t enumerate_half(mitm_data *d, uint32_t bi, const uint32_t last_bi, uint32_t first_cell, uint32_t in_row, uint64_t sum, half_callback g)
+{
+  const uint32_t r = d->r, s = d->s, n = d->n;
+
+  // an empty range of bloc rows, as the top half when s == 1, has the empty half-selection only
+  if (bi == last_bi)
+    return (*g)(d, sum);
+
+  if (in_row == r)
+    return enumerate_half(d, bi + 1, last_bi, 0, 0, sum, g);
+
+  // keep enough cells for the entries left in the bloc row
+  for (uint32_t c = first_cell; c + (r - in_row) <= r * n; ++c)
+  {
+    const uint32_t i = bi * r + c / n;
+    const uint32_t j = c % n;
+    const uint32_t bj = j / s;
+
+    if (d->col_count[bj] >= s)
+      continue;
+
+    const uint64_t next_sum = sum + d->pows[i * n + j];
+    // powers are positive: the sum can only grow
+    if (next_sum > d->mu)
+      continue;
+
+    ++(d->col_count[bj]);
+    GET_AS_MAT(d->selected, i, j, n) = 1;
+    d->items[d->count++] = i * n + j;
+
+    const uint8_t cont = enumerate_half(d, bi, last_bi, c + 1, in_row + 1, next_sum, g);
+
+    --(d->count);
+    GET_AS_MAT(d->selected, i, j, n) = 0;
+    --(d->col_count[bj]);
+
+    if (!cont)
+      return 0;
+  }
+
+  return 1;
+}
+
+static uint8_t store_top_half(mitm_data *d, uint64_t sum)
+{
+  if (d->top_count >= d->top_capacity)
+  {
+    d->top_capacity = d->top_capacity ? 2 * d->top_capacity : 1024;
+    d->top = realloc(d->top, d->top_capacity * sizeof(mitm_entry));
+    // top_width is 0 when s == 1, realloc might then return NULL
+    const size_t items_size = d->top_capacity * d->top_width * sizeof(rel_item);
+    d->top_items = realloc(d->top_items, items_size ? items_size : 1);
+    if (d->top == NULL || d->top_items == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+  }
+
+  d->top[d->top_count] = (mitm_entry) {.sum = sum, .sig = current_signature(d), .index = d->top_count};
+  memcpy(d->top_items + d->top_count * d->top_width, d->items, d->top_width * sizeof(rel_item));
+  ++(d->top_count);
+
+  return 1;
+}
+
+static int cmp_mitm_entry(const void *a, const void *b)
+{
+  const mitm_entry *x = a, *y = b;
+  if (x->sig != y->sig)
+    return x->sig < y->sig ? -1 : 1;
+  if (x->sum != y->sum)
+    return x->sum < y->sum ? -1 : 1;
+  return 0;
+}
+
+/*
+ * returns the index of the first top entry not smaller than (sig, sum)
+ */
+static size_t lower_bound_top(const mitm_data *d, col_signature sig, uint64_t sum)
+{
+  size_t lo = 0, hi = d->top_count;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    const mitm_entry e = d->top[mid];
+    if (e.sig < sig || (e.sig == sig && e.sum < sum))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/*
+ * Format:
+ * [   r   ][   s   ][   mu   ][  tag   ][ resume_from ][ resume_match ]
+ * uint32_t uint32_t uint64_t  uint64_t  uint64_t      uint64_t
+ */
+static void save_mitm_checkpoint(const mitm_data *d, uint64_t resume_from, uint64_t resume_match)
+{
+  if (d->checkpoint_file == NULL)
+    return;
+
+  // write then rename, so that an interrupted write never loses the previous checkpoint
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", d->checkpoint_file);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "[ERROR] Could not open file %s: %s\n", tmp, strerror(errno));
+    return;
+  }
+  fwrite(&d->r, sizeof(d->r), 1, f);
+  fwrite(&d->s, sizeof(d->s), 1, f);
+  fwrite(&d->mu, sizeof(d->mu), 1, f);
+  fwrite(&d->tag, sizeof(d->tag), 1, f);
+  fwrite(&resume_from, sizeof(resume_from), 1, f);
+  fwrite(&resume_match, sizeof(resume_match), 1, f);
+  fclose(f);
+
+  if (rename(tmp, d->checkpoint_file) != 0)
+    fprintf(stderr, "[ERROR] Could not rename %s: %s\n", tmp, strerror(errno));
+
+  return;
+}
+
+/*
+ * sets resume_from and resume_match from the checkpoint, leaves them to 0 if there is no matching checkpoint
+ */
+static void load_mitm_checkpoint(mitm_data *d)
+{
+  if (d->checkpoint_file == NULL)
+    return;
+
+  FILE *f = fopen(d->checkpoint_file, "rb");
+  if (f == NULL)
+    return;
+
+  uint32_t r = 0, s = 0;
+  uint64_t mu = 0, tag = 0, resume_from = 0, resume_match = 0;
+  const uint8_t ok = fread(&r, sizeof(r), 1, f) == 1 && fread(&s, sizeof(s), 1, f) == 1
+                  && fread(&mu, sizeof(mu), 1, f) == 1 && fread(&tag, sizeof(tag), 1, f) == 1
+                  && fread(&resume_from, sizeof(resume_from), 1, f) == 1
+                  && fread(&resume_match, sizeof(resume_match), 1, f) == 1;
+  fclose(f);
+
+  if (!ok || r != d->r || s != d->s || mu != d->mu || tag != d->tag)
+  {
+    fprintf(stderr, "[WARNING] Ignoring checkpoint %s: it does not belong to this square\n", d->checkpoint_file);
+    return;
+  }
+
+  d->resume_from = resume_from;
+  d->resume_match = resume_match;
+  return;
+}
+
+static uint8_t join_bottom_half(mitm_data *d, uint64_t sum)
+{
+  const uint64_t index = d->bottom_index++;
+  if (index < d->resume_from)
+    return 1;
+
+  if (index % MITM_CHECKPOINT_INTERVAL == 0)
+  {
+    save_mitm_checkpoint(d, index, 0);
+#ifndef __NO_GUI__
+    clear();
+    move(0, 0);
+    printw("top half-selections: %zu, bottom half-selections joined: %"PRIu64"\n", d->top_count, index);
+    print_perfw(d->perf, "sets");
+    refresh();
+#else
+    printf("\rtop half-selections: %zu, bottom half-selections joined: %"PRIu64, d->top_count, index);
+    fflush(stdout);
+#endif
+  }
+
+  const col_signature sig = complement_signature(d, current_signature(d));
+  const uint64_t key = d->mu - sum;
+
+  size_t k = lower_bound_top(d, sig, key);
+  const size_t first = k;
+  if (index == d->resume_from)
+    k += d->resume_match;
+
+  for (; k < d->top_count && d->top[k].sig == sig && d->top[k].sum == key; ++k)
+  {
+    const rel_item *items = d->top_items + (size_t)d->top[k].index * d->top_width;
+
+    // both halves lie in different bloc rows, they cannot overlap
+    for (uint32_t l = 0; l < d->top_width; ++l)
+      d->selected[items[l]] = 1;
+
+    perf_counter_tick(d->perf);
+    const uint8_t cont = (*d->f)(d->selected, d->n, d->data);
+
+    for (uint32_t l = 0; l < d->top_width; ++l)
+      d->selected[items[l]] = 0;
+
+    // the exact cursor, so that a resume never gives this set again
+    save_mitm_checkpoint(d, index, k + 1 - first);
+
+    if (!cont)
+      return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * calls f on every set of M with the magic sum, each one exactly once even across resumes: the checkpoint is saved
+ * after every set given, only a crash while f runs might give that set again
+ * if checkpoint_file is not NULL, the progress is saved to it, and with resume the search goes on from it if it exists,
+ * once the search went through every set the file is removed
+ * the top half-selections are kept in memory: about C(r * n, r)^(s/2) of them
+ */
+void find_sets_meet_in_the_middle(pow_m_sqr M, const uint32_t r, const uint32_t s, const char *checkpoint_file, uint8_t resume, perf_counter* perf, set_callback f, void *data)
+{
+  const uint32_t n = r * s;
+
+  if (r > 8 || s > 15)
+  {
+    fprintf(stderr, "[ERROR] The meet-in-the-middle search needs r <= 8 and s <= 15 for the column signatures, got r = %u, s = %u\n", r, s);
+    return;
+  }
+
+  mitm_data d = {
+    .M = &M, .r = r, .s = s, .n = n,
+    .mu = pow_m_sqr_sum_row(M, 0),
+    .top_width = r * (s / 2),
+    .checkpoint_file = checkpoint_file,
+    .perf = perf, .f = f, .data = data,
+  };
+
+  d.pows = calloc(n * n, sizeof(uint64_t));
+  d.selected = calloc(n * n, sizeof(uint8_t));
+  d.col_count = calloc(r, sizeof(uint32_t));
+  d.items = calloc(n, sizeof(rel_item));
+  if (d.pows == NULL || d.selected == NULL || d.col_count == NULL || d.items == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  d.tag = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < n; ++i)
+    for (uint32_t j = 0; j < n; ++j)
+    {
+      d.pows[i * n + j] = M_SQR_GET_POW_AS_MAT(M, i, j);
+      d.tag = (d.tag ^ d.pows[i * n + j]) * 1099511628211ULL;
+    }
+
+  if (resume)
+    load_mitm_checkpoint(&d);
+
+  enumerate_half(&d, 0, s / 2, 0, 0, 0, store_top_half);
+  qsort(d.top, d.top_count, sizeof(mitm_entry), cmp_mitm_entry);
+
+  if (enumerate_half(&d, s / 2, s, 0, 0, 0, join_bottom_half) && checkpoint_file != NULL)
+    remove(checkpoint_file);
+
+  free(d.pows);
+  free(d.selected);
+  free(d.col_count);
+  free(d.items);
+  free(d.top);
+  free(d.top_items);
+
+  return;
+}
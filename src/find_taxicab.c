@@ -14,6 +14,7 @@
 #include "find_taxicab.h"
 #include "probas.h"
 #include "arithmetic.h"
+#include "rng.h"
 
 #define MAX_BASE 256 // largement assez grand pour notre utilisation, pour des taxicab de taille 4x11 au plus
 #define HASH_SIZE 131071
@@ -113,13 +114,13 @@ int rep_equal(const Rep *a, const Rep *b)
   return 1;
 }
 
-int sample_unique_terms(int s, int *out)
+int sample_unique_terms(rng *g, int s, int *out)
 {
   int used[MAX_BASE + 1] = {0};
   int count = 0;
   while (count < s)
   {
-    int n = 1 + rand() % MAX_BASE;
+    int n = 1 + rng_bounded(g, MAX_BASE);
     if (!used[n])
     {
       used[n] = 1;
@@ -269,7 +270,7 @@ void cleanup(void)
   ht_cleanup(&global_ht);
 }
 
-uint64_t find_terms_ht(HashTable *ht, Rep *result_reps, int *terms, int r, int s);
+uint64_t find_terms_ht(rng *g, HashTable *ht, Rep *result_reps, int *terms, int r, int s);
 void reps_to_taxicab(taxicab T, Rep *reps);
 
 int test(int argc, char **argv)
@@ -289,7 +290,7 @@ int test(int argc, char **argv)
     return 1;
   }
 
-  srand(time(NULL));
+  rng_seed_global(time(NULL));
   if (!squares_inited)
   {
     init_squares();
@@ -327,14 +328,14 @@ void reps_to_taxicab(taxicab T, Rep *reps)
  * Core search: uses the supplied HashTable so callers control isolation.
  * Returns the taxicab sum; result_reps is filled on success.
  */
-uint64_t find_terms_ht(HashTable *ht, Rep *result_reps, int *terms, int r, int s)
+uint64_t find_terms_ht(rng *g, HashTable *ht, Rep *result_reps, int *terms, int r, int s)
 {
   Rep rep = {.terms = terms, .s = s};
   uint64_t result_sum = 0;
 
   while (1)
   {
-    sample_unique_terms(s, rep.terms);
+    sample_unique_terms(g, s, rep.terms);
     qsort(rep.terms, s, sizeof(int), cmp_int);
 
     uint64_t sum = 0;
@@ -360,7 +361,8 @@ uint64_t find_terms_ht(HashTable *ht, Rep *result_reps, int *terms, int r, int s
 /* Convenience wrapper that uses the legacy global table (unchanged behaviour) */
 uint64_t find_terms(Rep *result_reps, int *terms, int r, int s)
 {
-  return find_terms_ht(&global_ht, result_reps, terms, r, s);
+  rng g = rng_split_global();
+  return find_terms_ht(&g, &global_ht, result_reps, terms, r, s);
 }
 
 void find_taxicab(taxicab T)
@@ -430,6 +432,8 @@ int find_taxicabs_condition(taxicab a, taxicab b, double p, uint64_t mu)
     exit(1);
   }
 
+  rng g = rng_split_global();
+
   /* One independent table per taxicab — they never see each other's entries. */
   HashTable ht_a, ht_b;
   ht_init(&ht_a);
@@ -461,7 +465,7 @@ int find_taxicabs_condition(taxicab a, taxicab b, double p, uint64_t mu)
     }
     ++refresh_frames;
 
-    (void) find_terms_ht(&ht_a, result_reps_a, terms_a, r, s);
+    (void) find_terms_ht(&g, &ht_a, result_reps_a, terms_a, r, s);
     reps_to_taxicab(a, result_reps_a);
     curr1 = taxicab_sum_row(a, 0);
 
@@ -473,7 +477,7 @@ int find_taxicabs_condition(taxicab a, taxicab b, double p, uint64_t mu)
         ++broke_count;
         break;
       }
-      (void) find_terms_ht(&ht_b, result_reps_b, terms_b, s, r);
+      (void) find_terms_ht(&g, &ht_b, result_reps_b, terms_b, s, r);
       reps_to_taxicab(b, result_reps_b);
     } while (!taxicab_cross_products_are_distinct(a, b));
 
@@ -0,0 +1,660 @@
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hshtbl.h"
+#include "pow_m_sqr.h"
+
+void init_hshtbl(hshtbl* h, const uint32_t width)
+{
+  h->arr = calloc( HSHTBL_BASE_SIZE, sizeof(hshtbl_node));
+  h->capacity = HSHTBL_BASE_SIZE;
+  h->max_capacity = HSHTBL_MAX_SIZE;
+  h->count = 0;
+  h->read_only = 0;
+
+  h->width = width;
+  h->arena_capacity = HSHTBL_BASE_SIZE;
+  h->arena = calloc(h->arena_capacity * h->width, sizeof(rel_item));
+  if (h->arr == NULL || h->arena == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+}
+
+/*
+ * returns an array of n/2 hshtbls.
+ * hshtbl with index k will hold set of postions with k + 1 entries
+ */
+hshtbl *init_hshtbls(const uint32_t n)
+{
+  hshtbl *table = calloc(n/2, sizeof(hshtbl));
+  if (table == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+  for (uint32_t i = 0; i < n/2; ++i)
+    init_hshtbl(table + i, i + 1);
+  return table;
+}
+
+void empty_hshtbl(hshtbl *table)
+{
+  assert(!table->read_only);
+  memset(table->arr, 0, table->capacity * sizeof(*table->arr));
+  table->count = 0;
+
+  return;
+}
+
+/*
+ * the buffers of a mapped table belong to its hshtbls_mapping
+ */
+void free_hshtbl(hshtbl *table)
+{
+  if (!table->read_only)
+  {
+    free(table->arr);
+    free(table->arena);
+  }
+  table->arr = NULL;
+  table->arena = NULL;
+  table->count = 0;
+  table->arena_capacity = 0;
+  return;
+}
+
+
+void free_hshtbls(hshtbl *table, const uint32_t n)
+{
+  for (uint32_t k = 0; k < n/2; ++k)
+    free_hshtbl(table + k);
+
+  free(table);
+
+  return;
+}
+
+/*
+  set1 and set2 MUST have the same size of count ie set2_selected MUST have exactly count entries equal to 1 and every other being 0
+ */
+uint8_t sets_equal_items_selected(const rel_item *set1_items, const uint8_t *set2_selected, const uint64_t count, const uint64_t n)
+{
+  for (uint64_t k = 0; k < count; ++k)
+  {
+    const uint32_t i = set1_items[k] / n;
+    const uint32_t j = set1_items[k] % n;
+    if (!GET_AS_MAT(set2_selected, i, j, n))
+      return 0;
+  }
+
+  return 1;
+}
+
+void hshtbl_resize(hshtbl* table)
+{
+  // stop increasing table size
+  if (table->capacity >= table->max_capacity) return;
+
+  // table not full
+  if (table->count <= table->capacity * HSHTBL_FULLNESS_RATIO)
+    return;
+
+  const size_t prev_capa = table->capacity;
+
+  while (table->count > table->capacity * HSHTBL_FULLNESS_RATIO)
+    table->capacity *= 2ULL;
+
+  hshtbl_node* bigger = calloc(table->capacity, sizeof(table->arr[0]));
+  if (bigger == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  // only the nodes move, the items stay where they are in the arena
+  for (size_t i = 0; i < prev_capa; ++i)
+  {
+    if (table->arr[i].item)
+    {
+      uint32_t h = hash_func(table->arr[i].sum) % table->capacity;
+      while (bigger[h].item)
+        h = (h + 1) % table->capacity;
+
+      bigger[h] = table->arr[i];
+    }
+  }
+
+  free(table->arr);
+  table->arr = bigger;
+
+  return;
+}
+
+/*
+ * returns a pointer to the width rel_items of a new entry at the end of the arena
+ * the pointer is only valid until the next call, as the arena might move when growing
+ */
+rel_item *hshtbl_arena_push(hshtbl *table)
+{
+  if (table->count >= table->arena_capacity)
+  {
+    table->arena_capacity *= 2;
+    table->arena = realloc(table->arena, table->arena_capacity * table->width * sizeof(rel_item));
+    if (table->arena == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+  }
+
+  return table->arena + table->count * table->width;
+}
+
+/*
+ * modifies table
+ * items and selected are different representations of the same data
+ * count must be equal to table->width
+ */
+uint8_t hshtbl_insert(hshtbl *table, const rel_item *items, const uint8_t *selected, const uint32_t count, const uint64_t sum, const uint64_t n)
+{
+  assert(count == table->width);
+  assert(!table->read_only);
+
+  if (table->count > HSHTBL_MAX_FULLNESS_RATIO * table->capacity)
+    return HSHTBL_FULL;
+
+  uint64_t h = hash_func(sum) % table->capacity;
+
+  // there should always be space in the hshtbl has its occupancy must never be above HSHTBL_FULLNESS_RATIO
+  hshtbl_node node = table->arr[h];
+  while (node.item)
+  {
+    // equal sets must have equal sums
+    if (node.sum == sum && sets_equal_items_selected(HSHTBL_NODE_ITEMS(table, node), selected, count, n))
+      return HSHTBL_OK; // duplicate
+    h = (h + 1) % table->capacity;
+    node = table->arr[h];
+  };
+
+  memcpy(hshtbl_arena_push(table), items, count * sizeof(rel_item));
+
+  node.sum = sum;
+  node.item = ++table->count;
+
+  table->arr[h] = node;
+
+  hshtbl_resize(table);
+
+  return HSHTBL_OK;
+}
+
+/*
+ * hshtbl_insert for items which are known not to be in the table, without looking for a duplicate
+ * the table ends up the same as with hshtbl_insert
+ */
+uint8_t hshtbl_insert_unique(hshtbl *table, const rel_item *items, const uint32_t count, const uint64_t sum)
+{
+  assert(count == table->width);
+  assert(!table->read_only);
+
+  if (table->count > HSHTBL_MAX_FULLNESS_RATIO * table->capacity)
+    return HSHTBL_FULL;
+
+  uint64_t h = hash_func(sum) % table->capacity;
+  while (table->arr[h].item)
+    h = (h + 1) % table->capacity;
+
+  memcpy(hshtbl_arena_push(table), items, count * sizeof(rel_item));
+
+  table->arr[h].sum = sum;
+  table->arr[h].item = ++table->count;
+
+  hshtbl_resize(table);
+
+  return HSHTBL_OK;
+}
+
+// ----------- snapshots ---------------
+
+#define HSHTBL_SNAPSHOT_MAGIC (0x3130544253485348ULL) // "HSHTBL01"
+// the sections start on page boundaries, so that each one is mapped by whole pages
+#define HSHTBL_SNAPSHOT_ALIGN (4096)
+
+typedef struct
+{
+  uint64_t magic, key, table_count;
+} hshtbl_snapshot_header;
+
+typedef struct
+{
+  uint64_t count, capacity, width;
+  uint64_t arr_offset, arena_offset; // from the start of the file
+} hshtbl_snapshot_entry;
+
+static uint64_t hshtbl_snapshot_align(const uint64_t offset)
+{
+  return (offset + HSHTBL_SNAPSHOT_ALIGN - 1) / HSHTBL_SNAPSHOT_ALIGN * HSHTBL_SNAPSHOT_ALIGN;
+}
+
+static uint8_t hshtbl_snapshot_pad(FILE *f, const uint64_t offset)
+{
+  static const uint8_t zeroes[HSHTBL_SNAPSHOT_ALIGN] = {0};
+  const long pos = ftell(f);
+  if (pos < 0 || (uint64_t)pos > offset)
+    return 0;
+
+  return fwrite(zeroes, 1, offset - pos, f) == offset - pos;
+}
+
+/*
+ * returns 1 iff every non-empty node of the mapped arr points into the count entries of the arena
+ */
+static uint8_t hshtbl_snapshot_items_in_arena(const hshtbl_node *arr, const uint64_t capacity, const uint64_t count)
+{
+  for (uint64_t h = 0; h < capacity; ++h)
+    if (arr[h].item > count)
+      return 0;
+
+  return 1;
+}
+
+/*
+ * Format:
+ * [ header ][ count entries ] then for every table, at the offsets of its entry:
+ * [ capacity hshtbl_nodes ][ count * width rel_items ]
+ *            arr                    arena
+ * saves the count first tables, returns 1 on success
+ */
+uint8_t save_hshtbls(const char *file, const hshtbl *tables, const uint32_t count, const uint64_t key)
+{
+  hshtbl_snapshot_entry *entries = calloc(count, sizeof(hshtbl_snapshot_entry));
+  if (entries == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  uint64_t offset = sizeof(hshtbl_snapshot_header) + count * sizeof(hshtbl_snapshot_entry);
+  for (uint32_t k = 0; k < count; ++k)
+  {
+    entries[k].count = tables[k].count;
+    entries[k].capacity = tables[k].capacity;
+    entries[k].width = tables[k].width;
+    entries[k].arr_offset = hshtbl_snapshot_align(offset);
+    offset = entries[k].arr_offset + tables[k].capacity * sizeof(hshtbl_node);
+    entries[k].arena_offset = hshtbl_snapshot_align(offset);
+    offset = entries[k].arena_offset + tables[k].count * tables[k].width * sizeof(rel_item);
+  }
+
+  // write then rename, so that a process never maps a partial snapshot
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "[ERROR] Could not open file %s: %s\n", tmp, strerror(errno));
+    free(entries);
+    return 0;
+  }
+
+  const hshtbl_snapshot_header header = { HSHTBL_SNAPSHOT_MAGIC, key, count };
+  uint8_t ok = fwrite(&header, sizeof(header), 1, f) == 1
+            && fwrite(entries, sizeof(*entries), count, f) == count;
+  for (uint32_t k = 0; ok && k < count; ++k)
+  {
+    const size_t arena_len = tables[k].count * tables[k].width;
+    ok = hshtbl_snapshot_pad(f, entries[k].arr_offset)
+      && fwrite(tables[k].arr, sizeof(hshtbl_node), tables[k].capacity, f) == tables[k].capacity
+      && hshtbl_snapshot_pad(f, entries[k].arena_offset)
+      && fwrite(tables[k].arena, sizeof(rel_item), arena_len, f) == arena_len;
+  }
+  ok = (fclose(f) == 0) && ok;
+  free(entries);
+
+  if (!ok)
+  {
+    fprintf(stderr, "[ERROR] Could not write file %s: %s\n", tmp, strerror(errno));
+    remove(tmp);
+    return 0;
+  }
+  if (rename(tmp, file) != 0)
+  {
+    fprintf(stderr, "[ERROR] Could not rename %s: %s\n", tmp, strerror(errno));
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * points the count first tables into the snapshot of file, see save_hshtbls
+ * the tables must be initialized with the widths they were saved with, their buffers are released
+ * returns 1 on success, the tables are left untouched otherwise
+ */
+uint8_t map_hshtbls(const char *file, hshtbl *tables, const uint32_t count, const uint64_t key, hshtbls_mapping *mapping)
+{
+  FILE *f = fopen(file, "rb");
+  if (f == NULL)
+    return 0;
+
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0 || (size_t)st.st_size < sizeof(hshtbl_snapshot_header) + count * sizeof(hshtbl_snapshot_entry))
+  {
+    fprintf(stderr, "[WARNING] Ignoring %s: it is cut short\n", file);
+    fclose(f);
+    return 0;
+  }
+
+  const size_t size = st.st_size;
+  uint8_t *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+  fclose(f);
+  if (base == MAP_FAILED)
+  {
+    fprintf(stderr, "[WARNING] Could not mmap file %s: %s\n", file, strerror(errno));
+    return 0;
+  }
+
+  const hshtbl_snapshot_header *header = (const hshtbl_snapshot_header *)base;
+  const hshtbl_snapshot_entry *entries = (const hshtbl_snapshot_entry *)(header + 1);
+  uint8_t ok = header->magic == HSHTBL_SNAPSHOT_MAGIC && header->key == key && header->table_count == count;
+  for (uint32_t k = 0; ok && k < count; ++k)
+    ok = entries[k].width == tables[k].width
+      && entries[k].count < entries[k].capacity
+      && entries[k].arr_offset % HSHTBL_SNAPSHOT_ALIGN == 0
+      && entries[k].arena_offset % HSHTBL_SNAPSHOT_ALIGN == 0
+      && entries[k].arr_offset + entries[k].capacity * sizeof(hshtbl_node) <= size
+      && entries[k].arena_offset + entries[k].count * entries[k].width * sizeof(rel_item) <= size
+      && hshtbl_snapshot_items_in_arena((const hshtbl_node *)(base + entries[k].arr_offset), entries[k].capacity, entries[k].count);
+  if (!ok)
+  {
+    fprintf(stderr, "[WARNING] Ignoring %s: it does not match the tables\n", file);
+    munmap(base, size);
+    return 0;
+  }
+
+  for (uint32_t k = 0; k < count; ++k)
+  {
+    free_hshtbl(tables + k);
+    tables[k].count = entries[k].count;
+    tables[k].capacity = entries[k].capacity;
+    tables[k].max_capacity = entries[k].capacity;
+    tables[k].arena_capacity = entries[k].count;
+    tables[k].arr = (hshtbl_node *)(base + entries[k].arr_offset);
+    tables[k].arena = (rel_item *)(base + entries[k].arena_offset);
+    tables[k].read_only = 1;
+  }
+
+  mapping->base = base;
+  mapping->size = size;
+
+  return 1;
+}
+
+/*
+ * the tables pointing into mapping must have been freed
+ */
+void unmap_hshtbls(hshtbls_mapping *mapping)
+{
+  if (mapping->base != NULL)
+    munmap(mapping->base, mapping->size);
+  mapping->base = NULL;
+  mapping->size = 0;
+
+  return;
+}
+
+// ----------- lock-free version ---------------
+
+void init_lf_hshtbl(lf_hshtbl *table, const uint32_t width, const size_t capacity)
+{
+  // the slot is picked with a mask
+  assert((capacity & (capacity - 1)) == 0);
+
+  table->count = 0;
+  table->capacity = capacity;
+  table->max_count = HSHTBL_MAX_FULLNESS_RATIO * capacity;
+  table->width = width;
+
+  // a mapping of its own, so that emptying can drop its pages
+  table->arr = mmap(NULL, capacity * sizeof(lf_hshtbl_node), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  table->items = calloc(capacity * width, sizeof(rel_item));
+  if (table->arr == MAP_FAILED || table->items == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  return;
+}
+
+/*
+ * not thread safe: no other thread may use the table meanwhile
+ * only the slot states need to be cleared, sums and items are written before a slot becomes READY
+ */
+void empty_lf_hshtbl(lf_hshtbl *table)
+{
+  if (table->count == 0)
+    return;
+
+  // the private anonymous pages read back as zeroes, without being touched now
+  if (madvise(table->arr, table->capacity * sizeof(*table->arr), MADV_DONTNEED) != 0)
+    memset(table->arr, 0, table->capacity * sizeof(*table->arr));
+  table->count = 0;
+
+  return;
+}
+
+void free_lf_hshtbl(lf_hshtbl *table)
+{
+  if (table->arr != NULL)
+    munmap(table->arr, table->capacity * sizeof(*table->arr));
+  free(table->items);
+  table->arr = NULL;
+  table->items = NULL;
+  table->count = 0;
+
+  return;
+}
+
+size_t lf_hshtbl_count(const lf_hshtbl *table)
+{
+  return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
+
+/*
+ * thread safe
+ * same contract as hshtbl_insert, except that a duplicate might be stored if it is inserted at the same time
+ * as the original
+ */
+uint8_t lf_hshtbl_insert(lf_hshtbl *table, const rel_item *items, const uint8_t *selected, const uint32_t count, const uint64_t sum, const uint64_t n)
+{
+  assert(count == table->width);
+
+  if (__atomic_load_n(&table->count, __ATOMIC_RELAXED) >= table->max_count)
+    return HSHTBL_FULL;
+
+  const size_t mask = table->capacity - 1;
+
+  // max_count < capacity, hence there is always an empty slot down the probe chain
+  for (size_t h = hash_func(sum) & mask;; h = (h + 1) & mask)
+  {
+    lf_hshtbl_node *node = table->arr + h;
+    uint32_t state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+
+    if (state == LF_HSHTBL_EMPTY)
+    {
+      if (!__atomic_compare_exchange_n(&node->state, &state, LF_HSHTBL_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+      {
+        // another thread claimed the slot first, look at it again as it might be a duplicate
+        h = (h - 1) & mask;
+        continue;
+      }
+
+      node->sum = sum;
+      memcpy(LF_HSHTBL_SLOT_ITEMS(table, h), items, count * sizeof(rel_item));
+      __atomic_store_n(&node->state, LF_HSHTBL_READY, __ATOMIC_RELEASE);
+      __atomic_add_fetch(&table->count, 1, __ATOMIC_RELAXED);
+
+      return HSHTBL_OK;
+    }
+
+    // equal sets must have equal sums, BUSY slots cannot be compared yet
+    if (state == LF_HSHTBL_READY && node->sum == sum && sets_equal_items_selected(LF_HSHTBL_SLOT_ITEMS(table, h), selected, count, n))
+      return HSHTBL_OK; // duplicate
+  }
+}
+
+/*
+ * thread safe
+ * iterates over the READY slots holding a partial set of sum `sum`:
+ * pass h = -1 to get the first one, then the previously returned slot to get the next one
+ * returns -1 once the probe chain is exhausted
+ */
+int64_t lf_hshtbl_find_next(const lf_hshtbl *table, const uint64_t sum, int64_t h)
+{
+  const size_t mask = table->capacity - 1;
+
+  size_t i = h < 0 ? hash_func(sum) & mask : ((size_t)h + 1) & mask;
+  for (;; i = (i + 1) & mask)
+  {
+    const lf_hshtbl_node *node = table->arr + i;
+    const uint32_t state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+
+    if (state == LF_HSHTBL_EMPTY)
+      return -1;
+    if (state == LF_HSHTBL_READY && node->sum == sum)
+      return i;
+  }
+}
+
+// ----------- found sets ---------------
+
+/*
+ * 64 bits hash of the n sorted positions of a set, read 8 at a time
+ */
+uint64_t set_fingerprint(const rel_item *items, const uint32_t n)
+{
+  uint64_t acc = n;
+  for (uint32_t i = 0; i < n; i += 8)
+  {
+    uint64_t word = 0;
+    memcpy(&word, items + i, (n - i < 8 ? n - i : 8) * sizeof(rel_item));
+
+    // splitmix64 finalizer over the running state
+    acc ^= word + 0x9e3779b97f4a7c15ULL + (acc << 6) + (acc >> 2);
+    acc = (acc ^ (acc >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    acc = (acc ^ (acc >> 27)) * 0x94d049bb133111ebULL;
+    acc = acc ^ (acc >> 31);
+  }
+  return acc;
+}
+
+/*
+ * `expected` is the number of sets the table is sized for, it still grows past it
+ */
+void init_found_set_table(found_set_table *table, const uint32_t n, const size_t expected)
+{
+  table->count = 0;
+  table->capacity = HSHTBL_BASE_SIZE;
+  while (table->capacity * HSHTBL_FULLNESS_RATIO <= expected)
+    table->capacity *= 2;
+  table->n = n;
+  table->log_capacity = expected > 0 ? expected : HSHTBL_BASE_SIZE;
+
+  table->arr = calloc(table->capacity, sizeof(found_set_node));
+  table->log = calloc(table->log_capacity * n, sizeof(rel_item));
+  if (table->arr == NULL || table->log == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  return;
+}
+
+void free_found_set_table(found_set_table *table)
+{
+  free(table->arr);
+  free(table->log);
+  table->arr = NULL;
+  table->log = NULL;
+  table->count = 0;
+  return;
+}
+
+static void found_set_table_grow(found_set_table *table)
+{
+  const size_t prev_capa = table->capacity;
+  table->capacity *= 2;
+
+  found_set_node *bigger = calloc(table->capacity, sizeof(found_set_node));
+  if (bigger == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  const size_t mask = table->capacity - 1;
+  for (size_t i = 0; i < prev_capa; ++i)
+  {
+    if (!table->arr[i].index)
+      continue;
+
+    size_t h = table->arr[i].fingerprint & mask;
+    while (bigger[h].index)
+      h = (h + 1) & mask;
+    bigger[h] = table->arr[i];
+  }
+
+  free(table->arr);
+  table->arr = bigger;
+
+  return;
+}
+
+/*
+ * `items` are the n sorted positions of a set
+ * returns 1 if the set was not in the table and got added at the end of the log, 0 otherwise
+ */
+uint8_t found_set_table_insert(found_set_table *table, const rel_item *items)
+{
+  const uint64_t fingerprint = set_fingerprint(items, table->n);
+  const size_t mask = table->capacity - 1;
+
+  size_t h = fingerprint & mask;
+  for (; table->arr[h].index; h = (h + 1) & mask)
+    // a matching fingerprint is almost surely the same set, the log tells for sure
+    if (table->arr[h].fingerprint == fingerprint
+        && memcmp(FOUND_SET_ITEMS(table, table->arr[h].index - 1), items, table->n * sizeof(rel_item)) == 0)
+      return 0;
+
+  if (table->count >= table->log_capacity)
+  {
+    table->log_capacity *= 2;
+    table->log = realloc(table->log, table->log_capacity * table->n * sizeof(rel_item));
+    if (table->log == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+  }
+
+  memcpy(FOUND_SET_ITEMS(table, table->count), items, table->n * sizeof(rel_item));
+  table->arr[h].fingerprint = fingerprint;
+  table->arr[h].index = ++table->count;
+
+  if (table->count > table->capacity * HSHTBL_FULLNESS_RATIO)
+    found_set_table_grow(table);
+
+  return 1;
+}
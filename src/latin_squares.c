@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "types.h"
 #include "pow_m_sqr.h"
+#include "find_latin_squares.h"
 
 void latin_square_init(latin_square *P, uint64_t n)
 {
@@ -24,6 +26,84 @@ void latin_square_clear(latin_square *P)
   return;
 }
 
+/*
+ * every latin square of side n <= LATIN_SQUARE_TABLE_MAX_N, built on the first use of the side and kept
+ * iterate_over_all_square_callback fills the cells in row-major order with increasing values:
+ * the table is sorted lexicographically on the arrays of the squares
+ * a table is only published, through its arr, once filled: the lookups of the hot loops skip the mutex
+ */
+static latin_square_list latin_square_tables[LATIN_SQUARE_TABLE_MAX_N + 1];
+static pthread_mutex_t latin_square_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const latin_square_list *latin_square_table(uint32_t n)
+{
+  if (n > LATIN_SQUARE_TABLE_MAX_N)
+  {
+    fprintf(stderr, "[ERROR] There is no table of the latin squares of side %u > %u\n", n, LATIN_SQUARE_TABLE_MAX_N);
+    exit(1);
+  }
+
+  if (__atomic_load_n(&latin_square_tables[n].arr, __ATOMIC_ACQUIRE) != NULL)
+    return latin_square_tables + n;
+
+  pthread_mutex_lock(&latin_square_tables_mutex);
+  if (latin_square_tables[n].arr == NULL)
+  {
+    latin_square_list table;
+    latin_square_list_init(&table, n);
+    latin_square_tables[n].n = table.n;
+    latin_square_tables[n].count = table.count;
+    __atomic_store_n(&latin_square_tables[n].arr, table.arr, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&latin_square_tables_mutex);
+
+  return latin_square_tables + n;
+}
+
+/*
+ * index of P among the latin squares of its side with the first row 0, 1, ..., n - 1, in the order of
+ * iterate_over_all_square_callback
+ * returns the number of such squares if P is not one of them
+ */
+size_t latin_square_rank(const latin_square *P)
+{
+  const latin_square_list *table = latin_square_table(P->n);
+  const size_t size = P->n * P->n;
+
+  size_t lo = 0, hi = table->count;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp = memcmp(table->arr + mid * size, P->arr, size);
+    if (cmp == 0)
+      return mid;
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return table->count;
+}
+
+/*
+ * P becomes the latin square of index rank, see latin_square_rank
+ */
+void latin_square_unrank(latin_square *P, size_t rank)
+{
+  const latin_square_list *table = latin_square_table(P->n);
+  const size_t size = P->n * P->n;
+
+  if (rank >= table->count)
+  {
+    fprintf(stderr, "[ERROR] There are only %zu latin squares of side %u, %zu is out of range\n", table->count, P->n, rank);
+    exit(1);
+  }
+
+  memcpy(P->arr, table->arr + rank * size, size * sizeof(*P->arr));
+  return;
+}
+
 /*
  * 0 | 1 | 2 | 3
  * 1 | 2 | 3 | 0
@@ -20,6 +20,8 @@
 #include "serialize.h"
 #include "taxicab_method.h"
 #include "taxicab_method_mt.h"
+#include "find_latin_squares_mt.h"
+#include "rng.h"
 
 #include "perf_counter.h"
 
@@ -29,14 +31,23 @@ typedef struct run_data_s
 {
   size_t requiered_sets;
   size_t max_threads;
+  size_t chunk_size;
   bool no_taxicab_method;
   bool use_multithreading;
   bool new_taxicabs;
+  bool exhaustive;
+  bool join_sets;
   double min_proba;
   uint64_t max_sum;
   bool regen_latin_square_list;
+  bool verify_latin_square_list;
+  bool stream_latin_squares;
+  bool snapshot_sets;
+  bool prefill_sets;
+  char* resume_dir;
   bool help;
   uint64_t r, s, d;
+  uint64_t seed;
   char base_file_name[256];
   method m;
   FILE* info;
@@ -56,14 +67,17 @@ int do_run(run_data* run);
 
 int main(int argc, char **argv)
 {
-  run_data run = {.requiered_sets = 0, .max_threads = DEFAULT_MAX_THREADS, .no_taxicab_method = false,
-    .use_multithreading = false, .new_taxicabs = false, .min_proba = DEFAUL_MIN_PROBA, .max_sum = DEFAULT_MAX_SUM,
+  run_data run = {.requiered_sets = 0, .max_threads = DEFAULT_MAX_THREADS, .chunk_size = DEFAULT_LATIN_SQUARE_CHUNK, .no_taxicab_method = false,
+    .use_multithreading = false, .new_taxicabs = false, .exhaustive = false, .min_proba = DEFAUL_MIN_PROBA, .max_sum = DEFAULT_MAX_SUM,
     .regen_latin_square_list = false, .r = 3, .s = 4, .d = 2};
 
   if (!parse_args(argc, argv, &run)) return 1;
 
-  // srand(69);
-  srand(time(NULL));
+  // 0 means no seed given: pick one, print it so that the run can be replayed
+  if (run.seed == 0)
+    run.seed = time(NULL);
+  rng_seed_global(run.seed);
+  fprintf(stderr, "seed: %"PRIu64"\n", run.seed);
 
 #ifndef __NO_GUI__
   atexit(exit_fun);
@@ -97,10 +111,10 @@ void show_starting_stats_on_square(run_data* run)
   refresh();
   getch();
 #else
-  taxicab_printf(a);
-  printf("\nis%s a (%"PRIu32", %"PRIu32", %"PRIu32")-taxicab\n", is_taxicab(a) ? "" : " not", run->a.r, run->a.s, run->a.d);
-  taxicab_printf(b);
-  printf("\nis%s a (%"PRIu32", %"PRIu32", %"PRIu32")-taxicab\n", is_taxicab(b) ? "" : " not", run->b.r, run->b.s, run->b.d);
+  taxicab_printf(run->a);
+  printf("\nis%s a (%"PRIu32", %"PRIu32", %"PRIu32")-taxicab\n", is_taxicab(run->a) ? "" : " not", run->a.r, run->a.s, run->a.d);
+  taxicab_printf(run->b);
+  printf("\nis%s a (%"PRIu32", %"PRIu32", %"PRIu32")-taxicab\n", is_taxicab(run->b) ? "" : " not", run->b.r, run->b.s, run->b.d);
 #endif
 
   const double p_no_latin = proba_without_latin_square(run->sq);
@@ -159,16 +173,25 @@ void usage(FILE* stream)
 int parse_args(int argc, char** argv, run_data* run)
 {
   flag_bool_var  (&run->use_multithreading,      "mt",             false,               "use multithreaded search for the latin square enumeration");
-  flag_uint64_var(&run->max_threads,             "threads",        DEFAULT_MAX_THREADS, "the number of threads to use for the latin square enumeration");
+  flag_uint64_var(&run->max_threads,             "threads",        DEFAULT_MAX_THREADS, "the number of threads to use for the set search and the latin square enumeration");
+  flag_uint64_var(&run->chunk_size,              "chunk",          DEFAULT_LATIN_SQUARE_CHUNK, "the number of latin square arrays a thread claims at once");
   flag_bool_var  (&run->new_taxicabs,            "new-taxi",       false,               "find new taxicabs satifiying the condition");
+  flag_bool_var  (&run->exhaustive,              "exhaustive",     false,               "search the sets exhaustively by meet-in-the-middle, with -resume it goes on from the sets.checkpoint of the run");
+  flag_bool_var  (&run->join_sets,               "join",           false,               "find the sets by joining sorted batches of partial sets instead of the collision method");
   flag_double_var(&run->min_proba,               "p",              DEFAUL_MIN_PROBA,    "the minimal number of expected solutions from the taxicabs");
   flag_uint64_var(&run->max_sum,                 "sum",            DEFAULT_MAX_SUM,     "the maximal magic sum of the pair of taixcabs");
-  flag_bool_var  (&run->regen_latin_square_list, "regen",          false,               "regenerate the list of all latin squares");
+  flag_bool_var  (&run->regen_latin_square_list, "regen",          false,               "regenerate the list of all latin squares, and the lookup tables of each array (squares.latin_square_inv)");
+  flag_bool_var  (&run->verify_latin_square_list, "verify",        false,               "check that the list of all latin squares only holds latin squares, each one the representative of its class, before the search");
+  flag_bool_var  (&run->stream_latin_squares,    "stream",         false,               "with -mt, generate the latin square arrays on the fly instead of reading ./squares.latin_square");
+  flag_bool_var  (&run->snapshot_sets,           "snapshot",       false,               "save the partial sets of the collision method every ten minutes, for -resume to start from");
+  flag_bool_var  (&run->prefill_sets,            "prefill",        false,               "keep the prefilled tables of the collision method in ./sets-<hash>.prefill, mapped by the next runs on the same square");
+  flag_str_var   (&run->resume_dir,              "resume",         "",                  "the output directory of an interrupted -mt run to pick the latin square scan up from");
   flag_bool_var  (&run->no_taxicab_method,       "no-taxi-method", false,               "wether to use the taxicab method or not");
   flag_bool_var  (&run->help,                    "help",           false,               "show this help message");
   flag_uint64_var(&run->r,                       "r",              3,                   "value of r");
   flag_uint64_var(&run->s,                       "s",              4,                   "value of s");
   flag_uint64_var(&run->d,                       "d",              2,                   "value of d");
+  flag_uint64_var(&run->seed,                    "seed",           0,                   "seed of the random number generators, 0 for a time based one");
 
   if (!flag_parse(argc, argv))
   {
@@ -206,23 +229,41 @@ void exit_fun(void)
 
 int do_run(run_data* run)
 {
-  get_file_name_identifier(run->base_file_name, 255,
-      temp_sprintf("output/%s-out-", !run->no_taxicab_method ? "taxi" : "method"),
-      "/");
-  if (!mkdir_if_not_exists(run->base_file_name)) exit(1);
+  // a resumed run goes on in the directory of the interrupted one, with its taxicabs and rels
+  const bool resume = run->resume_dir[0] != '\0';
+  if (resume)
+  {
+    const size_t len = strlen(run->resume_dir);
+    snprintf(run->base_file_name, 255, "%s%s", run->resume_dir, run->resume_dir[len - 1] == '/' ? "" : "/");
+    run->use_multithreading = true;
+    run->no_taxicab_method = false;
+  }
+  else
+  {
+    get_file_name_identifier(run->base_file_name, 255,
+        temp_sprintf("output/%s-out-", !run->no_taxicab_method ? "taxi" : "method"),
+        "/");
+    if (!mkdir_if_not_exists(run->base_file_name)) exit(1);
+  }
 
-  run->info = fopen(temp_sprintf("%sinfo.txt", run->base_file_name), "w");
+  run->info = fopen(temp_sprintf("%sinfo.txt", run->base_file_name), resume ? "a" : "w");
   if (run->info == NULL)
   {
     fprintf(stderr, "[ERORR] Could not open file %sinfo.txt: %s", run->base_file_name, strerror(errno));
     exit(1);
   }
-  fprintf(run->info, "r=%"PRIu64",s=%"PRIu64",d=%"PRIu64"\n", run->r, run->s, run->d);
 
   perf_counter_init(&run->perf, 5.0);
 
-  run->new_taxicabs = run->new_taxicabs || run->r != 3 || run->s != 4;
-  if (run->new_taxicabs)
+  run->new_taxicabs = !resume && (run->new_taxicabs || run->r != 3 || run->s != 4);
+  if (resume)
+  {
+    load_taxicabs(run->base_file_name, &run->a, "a", &run->b, "b");
+    run->r = run->a.r;
+    run->s = run->a.s;
+    run->d = run->a.d;
+  }
+  else if (run->new_taxicabs)
   {
     taxicab_init(&run->a, run->r, run->s, run->d);
     taxicab_init(&run->b, run->s, run->r, run->d);
@@ -239,6 +280,7 @@ int do_run(run_data* run)
     load_taxicabs("./know/12x12-2/", &run->a, "a", &run->b, "b");
 
   const double taxicab_time = timer_stop(&run->perf.time);
+  fprintf(run->info, "r=%"PRIu64",s=%"PRIu64",d=%"PRIu64"\n", run->r, run->s, run->d);
   fprintf(run->info, "%s the taxicabs took %fs\n", run->new_taxicabs ? "finding" : "loading", taxicab_time);
 
   pow_m_sqr_init(&run->sq, run->a.r * run->a.s, run->a.d);
@@ -247,11 +289,14 @@ int do_run(run_data* run)
 
   show_starting_stats_on_square(run);
 
-  save_taxicabs(run->base_file_name, run->a, "a", run->b, "b");
+  if (!resume)
+    save_taxicabs(run->base_file_name, run->a, "a", run->b, "b");
 
   if (!run->no_taxicab_method)
   {
-    if (run->regen_latin_square_list || !file_exists("./squares.latin_square"))
+    const bool stream = run->use_multithreading && run->stream_latin_squares;
+
+    if (!stream && (run->regen_latin_square_list || !file_exists("./squares.latin_square") || !file_exists("./squares.latin_square_inv")))
     {
       latin_square* P = calloc(run->r, sizeof(latin_square));
       latin_square* Q = calloc(run->s, sizeof(latin_square));
@@ -270,10 +315,21 @@ int do_run(run_data* run)
       free(Q);
     }
 
+    // the search trusts the list: it does not check the squares on the way
+    if (!stream && run->verify_latin_square_list)
+    {
+      const size_t invalid = verify_all_latin_square_arrays("./", "squares");
+      if (invalid > 0)
+      {
+        fprintf(stderr, "[ABORT] %zu latin square arrays of ./squares.latin_square are broken, run with -regen\n", invalid);
+        exit(1);
+      }
+    }
+
     if (run->use_multithreading)
-      search_pow_m_sqr_from_taxicabs_mt(&run->perf, run->base_file_name, run->sq, run->a, run->b, run->requiered_sets, run->max_threads);
+      search_pow_m_sqr_from_taxicabs_mt(&run->perf, run->base_file_name, run->sq, run->a, run->b, run->requiered_sets, run->max_threads, run->chunk_size, run->exhaustive, run->join_sets, stream, resume, run->snapshot_sets, run->prefill_sets);
     else
-      search_pow_m_sqr_from_taxicabs(&run->perf, run->base_file_name, run->sq, run->a, run->b, run->requiered_sets);
+      search_pow_m_sqr_from_taxicabs(&run->perf, run->base_file_name, run->sq, run->a, run->b, run->requiered_sets, run->exhaustive, run->join_sets, run->snapshot_sets, run->prefill_sets);
   }
   else
   {
@@ -287,7 +343,7 @@ int do_run(run_data* run)
       semi_to_full_simultanious_perm(&run->perf, run->sq);
       break;
     case METHOD_SQRT_MU:
-      TODO("sqrt(mu)");
+      semi_to_full_meet_in_the_middle(&run->perf, run->sq);
       break;
     case METHOD_NONE:
     case METHOD_COUNT:
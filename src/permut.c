@@ -78,6 +78,141 @@ void position_after_latin_square_permutation(uint32_t *ret_row, uint32_t *ret_co
   return;
 }
 
+/*
+ * fills inv for the array P, Q: the searches of v' and u' in position_after_latin_square_permutation are done once
+ * here for every (i, j, u, v), instead of once per cell per call
+ */
+static void latin_squares_inv_compute_from_squares(latin_squares_inv *inv, const uint8_t *const *P, const uint8_t *const *Q, const uint32_t r, const uint32_t s)
+{
+  inv->r = r;
+  inv->s = s;
+
+  uint8_t *P_map = inv->tables;
+  uint8_t *Q_map = inv->tables + r * s * s;
+  inv->P_map = P_map;
+  inv->Q_map = Q_map;
+
+  // [P_standart]_{i, v} = (i + v) % s: the column of x in the row i of P_standart is (x - i) mod s
+  for (uint32_t j = 0; j < r; ++j)
+    for (uint32_t i = 0; i < s; ++i)
+      for (uint32_t v_prime = 0; v_prime < s; ++v_prime)
+      {
+        const uint32_t x = GET_AS_MAT(P[j], i, v_prime, s);
+        P_map[(j * s + i) * s + (x + s - i) % s] = v_prime;
+      }
+
+  for (uint32_t i = 0; i < s; ++i)
+    for (uint32_t j = 0; j < r; ++j)
+      for (uint32_t u_prime = 0; u_prime < r; ++u_prime)
+      {
+        const uint32_t x = GET_AS_MAT(Q[i], j, u_prime, r);
+        Q_map[(i * r + j) * r + (x + r - j) % r] = u_prime;
+      }
+
+  return;
+}
+
+void latin_squares_inv_compute(latin_squares_inv *inv, const latin_square *P, const latin_square *Q, const uint32_t r, const uint32_t s)
+{
+  const uint8_t *P_arr[16], *Q_arr[16];
+  for (uint32_t j = 0; j < r; ++j)
+    P_arr[j] = P[j].arr;
+  for (uint32_t i = 0; i < s; ++i)
+    Q_arr[i] = Q[i].arr;
+
+  latin_squares_inv_compute_from_squares(inv, P_arr, Q_arr, r, s);
+  return;
+}
+
+/*
+ * same as latin_squares_inv_compute, for an array as laid out in the .latin_square file:
+ * the r squares of side s of P, then the s squares of side r of Q
+ */
+void latin_squares_inv_compute_from_array(latin_squares_inv *inv, const uint8_t *array, const uint32_t r, const uint32_t s)
+{
+  const uint8_t *P_arr[16], *Q_arr[16];
+  for (uint32_t j = 0; j < r; ++j)
+    P_arr[j] = array + j * s*s;
+  for (uint32_t i = 0; i < s; ++i)
+    Q_arr[i] = array + r * s*s + i * r*r;
+
+  latin_squares_inv_compute_from_squares(inv, P_arr, Q_arr, r, s);
+  return;
+}
+
+/*
+ * points inv to maps computed beforehand, laid out as the tables of latin_squares_inv_compute, nothing is copied
+ */
+void latin_squares_inv_from_maps(latin_squares_inv *inv, const uint8_t *maps, const uint32_t r, const uint32_t s)
+{
+  inv->r = r;
+  inv->s = s;
+  inv->P_map = maps;
+  inv->Q_map = maps + r * s * s;
+  return;
+}
+
+/*
+ * same as position_after_latin_square_permutation, with the tables of latin_squares_inv_compute
+ */
+void position_after_latin_square_permutation_inv(uint32_t *ret_row, uint32_t *ret_col, rel_item row, rel_item col, const latin_squares_inv *inv)
+{
+  const uint32_t r = inv->r, s = inv->s;
+  const uint32_t i = row / r;
+  const uint32_t j = col / s;
+  const uint32_t u = row % r;
+  const uint32_t v = col % s;
+
+  *ret_row = i * r + inv->Q_map[(i * r + j) * r + u];
+  *ret_col = j * s + inv->P_map[(j * s + i) * s + v];
+  return;
+}
+
+/*
+ * rows and cols MUST be a n*uint8_t array
+ */
+uint8_t fall_on_different_line_after_latin_squares_inv(uint8_t* rows, uint8_t* cols, rel_item *poses, const latin_squares_inv *inv)
+{
+  const uint64_t n = inv->r * inv->s;
+
+  for (uint64_t k = 0; k < n; ++k)
+  {
+    uint32_t new_row = 0, new_col = 0;
+    position_after_latin_square_permutation_inv(&new_row, &new_col, poses[k] / n, poses[k] % n, inv);
+
+    if (rows[new_row] || cols[new_col])
+      return 0;
+    rows[new_row] = 1;
+    cols[new_col] = 1;
+  }
+
+  return 1;
+}
+
+/*
+ * fall_on_different_line_after_latin_squares_inv and x_y_rel_after_latin_squares_inv in a single pass
+ * ret is only complete if the entries fall on different lines, ie if non-zero is returned
+ * rows and cols MUST be a n*uint8_t array
+ */
+uint8_t x_y_rel_after_latin_squares_inv_checked(x_y_rel ret, uint8_t* rows, uint8_t* cols, pos_rel op, const latin_squares_inv *inv)
+{
+  const uint64_t n = inv->r * inv->s;
+
+  for (uint64_t k = 0; k < n; ++k)
+  {
+    uint32_t new_row = 0, new_col = 0;
+    position_after_latin_square_permutation_inv(&new_row, &new_col, op[k] / n, op[k] % n, inv);
+
+    if (rows[new_row] || cols[new_col])
+      return 0;
+    rows[new_row] = 1;
+    cols[new_col] = 1;
+    ret[new_row] = new_col;
+  }
+
+  return 1;
+}
+
 /*
  * rows and cols MUST be a n*uint8_t array
  */
@@ -336,6 +471,8 @@ void pow_m_sqr_from_highlighted_square(pow_m_sqr *ret, rel_item *rel1, rel_item
       }
     }
 
+  pow_m_sqr_update_pows(*ret);
+
   return;
 }
 
@@ -389,3 +526,72 @@ void x_y_rel_after_latin_squares(x_y_rel ret, pos_rel op, latin_square* P, latin
 
   return;
 }
+
+void x_y_rel_after_latin_squares_inv(x_y_rel ret, pos_rel op, const latin_squares_inv *inv)
+{
+  const size_t n = inv->r * inv->s;
+  for (size_t k = 0; k < n; ++k)
+  {
+    uint32_t new_row, new_col;
+    position_after_latin_square_permutation_inv(&new_row, &new_col, op[k] / n, op[k] % n, inv);
+
+    ret[new_row] = new_col;
+  }
+
+  return;
+}
+
+/*
+ * permutes the columns of the square arr of side n so that its first row becomes 0, 1, ..., n - 1
+ * the column c of the result is the column first_row^-1(c) of the input, stored in relabel[c] when relabel is not NULL
+ */
+static void latin_square_reduce_columns(uint8_t *arr, rel_item *relabel, const uint32_t n)
+{
+  uint8_t pos[16], tmp[16];
+  for (uint32_t c = 0; c < n; ++c)
+    pos[arr[c]] = c;
+
+  for (uint32_t row = 0; row < n; ++row)
+  {
+    for (uint32_t c = 0; c < n; ++c)
+      tmp[c] = GET_AS_MAT(arr, row, pos[c], n);
+    memcpy(arr + row * n, tmp, n);
+  }
+
+  if (relabel != NULL)
+    for (uint32_t c = 0; c < n; ++c)
+      relabel[c] = pos[c];
+
+  return;
+}
+
+/*
+ * brings the array, laid out as in the .latin_square file, to the representative of its class: every square gets
+ * its columns permuted until its first row is 0, 1, ..., n - 1, as the enumeration of the arrays produces them
+ *
+ * permuting the columns of Q[i] (resp. P[j]) only relabels the rows of the block i (resp. the columns of the block j)
+ * of the square the rels are sent to, which preserves fall_on_different_line_after_latin_squares and the disjointness
+ * of the rels: if x_y_rel_after_latin_squares sends op to ret with the representative, it sends op to
+ * row_relabel[row] -> col_relabel[ret[row]] with the original array
+ * conversely a relabeling of the lines that works for every rel has to keep the blocks and to fix the block 0 of the
+ * other direction, where the maps of the representatives are the identity, so the representatives of two different
+ * classes are never equivalent
+ *
+ * row_relabel and col_relabel are filled with r * s entries each when not NULL
+ */
+void latin_square_array_canonicalize(uint8_t *array, rel_item *row_relabel, rel_item *col_relabel, const uint32_t r, const uint32_t s)
+{
+  for (uint32_t j = 0; j < r; ++j)
+    latin_square_reduce_columns(array + j * s*s, col_relabel == NULL ? NULL : col_relabel + j * s, s);
+  for (uint32_t i = 0; i < s; ++i)
+    latin_square_reduce_columns(array + r * s*s + i * r*r, row_relabel == NULL ? NULL : row_relabel + i * r, r);
+
+  if (col_relabel != NULL)
+    for (uint32_t k = 0; k < r * s; ++k)
+      col_relabel[k] += (k / s) * s;
+  if (row_relabel != NULL)
+    for (uint32_t k = 0; k < r * s; ++k)
+      row_relabel[k] += (k / r) * r;
+
+  return;
+}
@@ -7,6 +7,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 // for extracting d-th root
@@ -17,6 +18,7 @@
 #include "perf_counter.h"
 #include "taxicab.h"
 #include "arithmetic.h"
+#include "rng.h"
 
 #include <ncurses.h>
 
@@ -24,7 +26,7 @@ uint64_t pow_m_sqr_sum_col(pow_m_sqr M, uint64_t j)
 {
   uint64_t acc = 0;
   for (uint64_t i = 0; i < M.n; ++i)
-    acc += ui_pow_ui(M_SQR_GET_AS_MAT(M, i, j), M.d);
+    acc += M_SQR_GET_POW_AS_MAT(M, i, j);
 
   return acc;
 }
@@ -33,7 +35,7 @@ uint64_t pow_m_sqr_sum_row(pow_m_sqr M, uint64_t i)
 {
   uint64_t acc = 0;
   for (uint64_t j = 0; j < M.n; ++j)
-    acc += ui_pow_ui(M_SQR_GET_AS_MAT(M, i, j), M.d);
+    acc += M_SQR_GET_POW_AS_MAT(M, i, j);
 
   return acc;
 }
@@ -42,7 +44,7 @@ uint64_t pow_m_sqr_sum_diag1(pow_m_sqr M)
 {
   uint64_t acc = 0;
   for (uint64_t k = 0; k < M.n; ++k)
-    acc += ui_pow_ui(M_SQR_GET_AS_MAT(M, k, k), M.d);
+    acc += M_SQR_GET_POW_AS_MAT(M, k, k);
 
   return acc;
 }
@@ -51,7 +53,7 @@ uint64_t pow_m_sqr_sum_diag2(pow_m_sqr M)
 {
   uint64_t acc = 0;
   for (uint64_t k = 0; k < M.n; ++k)
-    acc += ui_pow_ui(M_SQR_GET_AS_MAT(M, k, M.n - k - 1), M.d);
+    acc += M_SQR_GET_POW_AS_MAT(M, k, M.n - k - 1);
 
   return acc;
 }
@@ -162,9 +164,10 @@ int pow_m_sqr_init(pow_m_sqr *M, uint64_t n, uint64_t d)
   M->n = n;
   M->d = d;
   M->arr = calloc(n * n, sizeof(*(M->arr)));
+  M->pows = calloc(n * n, sizeof(*(M->pows)));
   M->cols = calloc(n, sizeof(*M->cols));
   M->rows = calloc(n, sizeof(*M->rows));
-  if (M->arr == NULL || M->cols == NULL || M->rows == NULL)
+  if (M->arr == NULL || M->pows == NULL || M->cols == NULL || M->rows == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
@@ -180,14 +183,28 @@ int pow_m_sqr_init(pow_m_sqr *M, uint64_t n, uint64_t d)
 void pow_m_sqr_clear(pow_m_sqr *M)
 {
   free(M->arr);
+  free(M->pows);
   free(M->cols);
   free(M->rows);
   M->arr = NULL;
+  M->pows = NULL;
   M->cols = NULL;
   M->rows = NULL;
   return;
 }
 
+/*
+ * recomputes the cache of d-th powers from arr
+ * the sums and the set searches only read the cache: it has to be called whenever the entries of arr or d change,
+ * permuting the rows and cols keeps it in sync
+ */
+void pow_m_sqr_update_pows(pow_m_sqr M)
+{
+  for (uint64_t idx = 0; idx < M.n * M.n; ++idx)
+    M_SQR_GET_POW_AS_VEC(M, idx) = ui_pow_ui(M_SQR_GET_AS_VEC(M, idx), M.d);
+  return;
+}
+
 enum
 {
   PARTIAL_M_SQR_VALID,
@@ -295,6 +312,9 @@ int search_pow_m_sqr(pow_m_sqr base, uint64_t X, uint64_t progress, uint8_t *hea
 
     for (uint64_t idx = 0; idx < progress; ++idx)
       heat_map[M_SQR_GET_AS_VEC(base, idx)] = 1;
+
+    // the entries after progress are kept in sync as they are placed
+    pow_m_sqr_update_pows(base);
   }
 
   if (progress == base.n * base.n)
@@ -329,7 +349,7 @@ int search_pow_m_sqr(pow_m_sqr base, uint64_t X, uint64_t progress, uint8_t *hea
     int64_t partial_sum = 0;
     uint64_t i = (progress + 1) / base.n - 1; // -1 for 0-index
     for (uint64_t j = 0; j < base.n - 1; ++j)
-      partial_sum += ui_pow_ui(M_SQR_GET_AS_MAT(base, i, j), base.d);
+      partial_sum += M_SQR_GET_POW_AS_MAT(base, i, j);
 
     mpz_t diff;
     mpz_init_set_si(diff, mu - partial_sum);
@@ -356,6 +376,7 @@ int search_pow_m_sqr(pow_m_sqr base, uint64_t X, uint64_t progress, uint8_t *hea
       continue;
     }
     heat_map[M_SQR_GET_AS_VEC(base, progress)] = 1;
+    M_SQR_GET_POW_AS_VEC(base, progress) = ui_pow_ui(M_SQR_GET_AS_VEC(base, progress), base.d);
 
     uint8_t flags = is_valid_partial_pow_m_sqr(base, progress);
     if (flags == PARTIAL_M_SQR_NEXT)
@@ -456,6 +477,8 @@ void pow_semi_m_sqr_from_taxicab(pow_m_sqr M, taxicab a, taxicab b, latin_square
   if (Q == NULL)
     latin_square_clear(&Q_standart);
 
+  pow_m_sqr_update_pows(M);
+
   return;
 }
 
@@ -480,6 +503,7 @@ void permute_cols(pow_m_sqr M, uint64_t *permut)
 
   free(M.arr);
   M.arr = arr_copy;
+  pow_m_sqr_update_pows(M);
 
   return;
 }
@@ -503,6 +527,7 @@ void permute_lines(pow_m_sqr M, uint64_t *permut)
       M_SQR_GET_AS_MAT(M, permut[i], j) = arr_copy[i * M.n + j];
 
   free(arr_copy);
+  pow_m_sqr_update_pows(M);
 
   return;
 }
@@ -551,11 +576,11 @@ void permute_lines(pow_m_sqr M, uint64_t *permut)
 /*
  * Fisher-Yates shuffle
  */
-void random_perm(uint64_t *l, size_t n)
+void random_perm(rng *g, uint64_t *l, size_t n)
 {
   for (size_t i = n - 1; i > 0; --i)
   {
-    size_t j = rand() % (i + 1);
+    size_t j = rng_bounded(g, i + 1);
 
     uint64_t t = l[j];
     l[j] = l[i];
@@ -568,7 +593,7 @@ void random_perm(uint64_t *l, size_t n)
 /*
  * applies the Fisher-Yates shuffle to the columns of M
  */
-void shuffle_cols(pow_m_sqr M)
+void shuffle_cols(rng *g, pow_m_sqr M)
 {
   uint64_t *l = calloc(M.n, sizeof(uint64_t));
   if (l == NULL)
@@ -580,7 +605,7 @@ void shuffle_cols(pow_m_sqr M)
   for (uint64_t i = 0; i < M.n; ++i)
     l[i] = i;
 
-  random_perm(l, M.n);
+  random_perm(g, l, M.n);
   permute_cols(M, l);
 
   free(l);
@@ -591,7 +616,7 @@ void shuffle_cols(pow_m_sqr M)
 /*
  * applies the Fisher-Yates shuffle to the lines of M
  */
-void shuffle_lines(pow_m_sqr M)
+void shuffle_lines(rng *g, pow_m_sqr M)
 {
   uint64_t *l = calloc(M.n, sizeof(uint64_t));
   if (l == NULL)
@@ -603,7 +628,7 @@ void shuffle_lines(pow_m_sqr M)
   for (uint64_t i = 0; i < M.n; ++i)
     l[i] = i;
 
-  random_perm(l, M.n);
+  random_perm(g, l, M.n);
   permute_lines(M, l);
 
   free(l);
@@ -611,7 +636,7 @@ void shuffle_lines(pow_m_sqr M)
   return;
 }
 
-void shuffle_lines_and_cols_with_same_perm(pow_m_sqr M)
+void shuffle_lines_and_cols_with_same_perm(rng *g, pow_m_sqr M)
 {
   uint64_t *l = calloc(M.n, sizeof(uint64_t));
   if (l == NULL)
@@ -623,7 +648,7 @@ void shuffle_lines_and_cols_with_same_perm(pow_m_sqr M)
   for (uint64_t i = 0; i < M.n; ++i)
     l[i] = i;
 
-  random_perm(l, M.n);
+  random_perm(g, l, M.n);
   permute_lines(M, l);
   permute_cols(M, l);
 
@@ -634,22 +659,127 @@ void shuffle_lines_and_cols_with_same_perm(pow_m_sqr M)
 
 #define REFRESH_RATE (0xfffff)
 
+/*
+ * transposition moves for the semi to full searches
+ * swapping two lines or two cols of a semi magic square keeps it semi magic and only changes the terms of the
+ * diagonals in the swapped lines/cols: the diagonal sums are updated in O(1) instead of being recomputed
+ * the swaps are done in place on M.rows and M.cols, nothing gets allocated
+ */
+typedef struct
+{
+  uint64_t diag1, diag2;
+} diag_sums;
+
+static inline uint64_t diag1_term(pow_m_sqr M, uint32_t k)
+{
+  return M_SQR_GET_POW_AS_MAT(M, k, k);
+}
+
+static inline uint64_t diag2_term(pow_m_sqr M, uint32_t k)
+{
+  return M_SQR_GET_POW_AS_MAT(M, k, M.n - k - 1);
+}
+
+/*
+ * a != b, uniformly
+ */
+static inline void random_pair(rng *g, uint32_t n, uint32_t *a, uint32_t *b)
+{
+  const uint32_t x = rng_bounded(g, n * (n - 1));
+  *a = x / (n - 1);
+  *b = x % (n - 1);
+  if (*b >= *a)
+    ++(*b);
+  return;
+}
+
+static void swap_lines_update_diags(pow_m_sqr M, uint32_t a, uint32_t b, diag_sums *sums)
+{
+  // the sums wrap around while the old terms are removed, they are back in range once the new ones are added
+  sums->diag1 -= diag1_term(M, a) + diag1_term(M, b);
+  sums->diag2 -= diag2_term(M, a) + diag2_term(M, b);
+
+  const uint32_t t = M.rows[a];
+  M.rows[a] = M.rows[b];
+  M.rows[b] = t;
+
+  sums->diag1 += diag1_term(M, a) + diag1_term(M, b);
+  sums->diag2 += diag2_term(M, a) + diag2_term(M, b);
+  return;
+}
+
+static void swap_cols_update_diags(pow_m_sqr M, uint32_t a, uint32_t b, diag_sums *sums)
+{
+  // col j holds the term of diag2 of line n - j - 1
+  const uint32_t a2 = M.n - a - 1, b2 = M.n - b - 1;
+  sums->diag1 -= diag1_term(M, a) + diag1_term(M, b);
+  sums->diag2 -= diag2_term(M, a2) + diag2_term(M, b2);
+
+  const uint32_t t = M.cols[a];
+  M.cols[a] = M.cols[b];
+  M.cols[b] = t;
+
+  sums->diag1 += diag1_term(M, a) + diag1_term(M, b);
+  sums->diag2 += diag2_term(M, a2) + diag2_term(M, b2);
+  return;
+}
+
+/*
+ * swaps lines a and b and cols a and b: the entries of diag1 are only reordered, diag2 changes on lines
+ * a, b, n - a - 1 and n - b - 1
+ */
+static void swap_lines_and_cols_update_diag2(pow_m_sqr M, uint32_t a, uint32_t b, diag_sums *sums)
+{
+  const uint32_t candidates[4] = {a, b, M.n - a - 1, M.n - b - 1};
+  uint32_t ks[4];
+  uint32_t count = 0;
+  for (uint32_t l = 0; l < 4; ++l)
+  {
+    uint8_t seen = 0;
+    for (uint32_t m = 0; m < count; ++m)
+      seen |= ks[m] == candidates[l];
+    if (!seen)
+      ks[count++] = candidates[l];
+  }
+
+  for (uint32_t l = 0; l < count; ++l)
+    sums->diag2 -= diag2_term(M, ks[l]);
+
+  uint32_t t = M.rows[a];
+  M.rows[a] = M.rows[b];
+  M.rows[b] = t;
+  t = M.cols[a];
+  M.cols[a] = M.cols[b];
+  M.cols[b] = t;
+
+  for (uint32_t l = 0; l < count; ++l)
+    sums->diag2 += diag2_term(M, ks[l]);
+  return;
+}
+
 /*
  * `M` is expected to contain a semi-magic square of powers
  * Is only likely to work if (n!)^2/( (n/2)! * 2^(n/2 + 1) ) > mu
  */
 void semi_to_full_naive(perf_counter* perf, pow_m_sqr M)
 {
+  rng g = rng_split_global();
   uint64_t mu = pow_m_sqr_sum_row(M, 0);
+  diag_sums sums = {.diag1 = pow_m_sqr_sum_diag1(M), .diag2 = pow_m_sqr_sum_diag2(M)};
   uint64_t curr1, curr2;
-  curr1 = pow_m_sqr_sum_diag1(M);
-  curr2 = pow_m_sqr_sum_diag2(M);
+  curr1 = sums.diag1;
+  curr2 = sums.diag2;
+  // random walk on the permutations of the lines and cols, one transposition at a time
   while (curr1 != mu || curr2 != mu)
   {
-    shuffle_lines(M);
-    curr1 = pow_m_sqr_sum_diag1(M);
-    shuffle_cols(M);
-    curr2 = pow_m_sqr_sum_diag2(M);
+    uint32_t a, b;
+    random_pair(&g, M.n, &a, &b);
+    if (rng_next(&g) & 1)
+      swap_lines_update_diags(M, a, b, &sums);
+    else
+      swap_cols_update_diags(M, a, b, &sums);
+    curr1 = sums.diag1;
+    curr2 = sums.diag2;
     perf_counter_tick(perf);
     if ((perf->counter & REFRESH_RATE) == 0)
     {
@@ -675,12 +805,16 @@ void semi_to_full_naive(perf_counter* perf, pow_m_sqr M)
  */
 void semi_to_full_simultanious_perm(perf_counter* perf, pow_m_sqr M)
 {
+  rng g = rng_split_global();
   uint64_t mu = pow_m_sqr_sum_row(M, 0);
+  diag_sums sums = {.diag1 = pow_m_sqr_sum_diag1(M), .diag2 = pow_m_sqr_sum_diag2(M)};
 
   uint64_t curr;
-  while ((curr = pow_m_sqr_sum_diag1(M)) != mu)
+  while ((curr = sums.diag1) != mu)
   {
-    shuffle_lines(M);
+    uint32_t a, b;
+    random_pair(&g, M.n, &a, &b);
+    swap_lines_update_diags(M, a, b, &sums);
     perf_counter_tick(perf);
     if ((perf->counter & REFRESH_RATE) == 0)
     {
@@ -699,9 +833,12 @@ void semi_to_full_simultanious_perm(perf_counter* perf, pow_m_sqr M)
 
   size_t counter1 = perf->counter;
 
-  while ((curr = pow_m_sqr_sum_diag2(M)) != mu)
+  // the same transposition on the lines and the cols keeps diag1
+  while ((curr = sums.diag2) != mu)
   {
-    shuffle_lines_and_cols_with_same_perm(M);
+    uint32_t a, b;
+    random_pair(&g, M.n, &a, &b);
+    swap_lines_and_cols_update_diag2(M, a, b, &sums);
     perf_counter_tick(perf);
     if ((perf->counter & REFRESH_RATE) == 0)
     {
@@ -721,6 +858,322 @@ void semi_to_full_simultanious_perm(perf_counter* perf, pow_m_sqr M)
   return;
 }
 
+/*
+ * meet-in-the-middle completion of the diagonals, in two stages:
+ *   1. diag1: the lines of each half of the square are permuted among themselves, every permutation of the first
+ *      half is tabulated by its sum along diag1 and joined with the ones of the second half
+ *   2. diag2: the same permutation is applied to the lines and the cols, which keeps diag1
+ *      if it sends the positions k and n - k - 1 to u and v, diag2 gets M_uv + M_vu: diag2 only depends on how
+ *      the permutation pairs the indices, the pairings inside each half are joined the same way
+ * when no pair of halves adds up to mu, the square is shuffled and the stage tried again
+ */
+typedef struct
+{
+  uint64_t sum;
+  uint32_t index; // in the items of the table
+} half_diag_entry;
+
+typedef struct half_diags_data_s
+{
+  pow_m_sqr M;
+  uint64_t target;
+
+  // current half: its elements are the global indices idx[0], ..., idx[width - 1]
+  const uint32_t *idx;
+  uint32_t width;
+  uint32_t used;      // bitmask of the elements already placed
+  uint8_t items[16];  // permutation or pairing of the elements of the half, as indices in idx
+
+  // first half
+  half_diag_entry *table;
+  uint8_t *table_items;
+  size_t count, capacity;
+  uint32_t table_width;
+  int64_t match;      // table index completing the items of the second half, -1 if none was found
+
+  perf_counter *perf;
+} half_diags_data;
+
+typedef uint8_t (*half_diags_callback)(half_diags_data *d, uint64_t sum);
+typedef uint8_t (*half_diags_enumerator)(half_diags_data *d, uint32_t depth, uint64_t sum, half_diags_callback g);
+
+/*
+ * enumerates the permutations of the lines of the half, items[l] is the line going to position l
+ * returns zero if the enumeration should stop
+ */
+static uint8_t enumerate_half_line_perms(half_diags_data *d, uint32_t depth, uint64_t sum, half_diags_callback g)
+{
+  if (depth == d->width)
+    return (*g)(d, sum);
+
+  const uint32_t k = d->idx[depth];
+  for (uint32_t l = 0; l < d->width; ++l)
+  {
+    if (d->used & (1u << l))
+      continue;
+
+    d->used |= 1u << l;
+    d->items[depth] = l;
+    const uint8_t cont = enumerate_half_line_perms(d, depth + 1, sum + M_SQR_GET_POW_AS_MAT(d->M, d->idx[l], k), g);
+    d->used &= ~(1u << l);
+
+    if (!cont)
+      return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * enumerates the pairings of the elements of the half, (items[2p], items[2p + 1]) is the p-th pair
+ * returns zero if the enumeration should stop
+ */
+static uint8_t enumerate_half_pairings(half_diags_data *d, uint32_t depth, uint64_t sum, half_diags_callback g)
+{
+  if (depth == d->width)
+    return (*g)(d, sum);
+
+  uint32_t first = 0;
+  while (d->used & (1u << first))
+    ++first;
+
+  d->used |= 1u << first;
+  uint8_t cont = 1;
+  for (uint32_t l = first + 1; cont && l < d->width; ++l)
+  {
+    if (d->used & (1u << l))
+      continue;
+
+    const uint32_t u = d->idx[first], v = d->idx[l];
+    d->used |= 1u << l;
+    d->items[depth] = first;
+    d->items[depth + 1] = l;
+    cont = enumerate_half_pairings(d, depth + 2, sum + M_SQR_GET_POW_AS_MAT(d->M, u, v) + M_SQR_GET_POW_AS_MAT(d->M, v, u), g);
+    d->used &= ~(1u << l);
+  }
+  d->used &= ~(1u << first);
+
+  return cont;
+}
+
+static uint8_t store_half_diag(half_diags_data *d, uint64_t sum)
+{
+  if (sum > d->target)
+    return 1;
+
+  if (d->count >= d->capacity)
+  {
+    d->capacity = d->capacity ? 2 * d->capacity : 1024;
+    d->table = realloc(d->table, d->capacity * sizeof(half_diag_entry));
+    d->table_items = realloc(d->table_items, d->capacity * d->table_width * sizeof(uint8_t));
+    if (d->table == NULL || d->table_items == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+  }
+
+  d->table[d->count] = (half_diag_entry) {.sum = sum, .index = d->count};
+  memcpy(d->table_items + d->count * d->table_width, d->items, d->table_width * sizeof(uint8_t));
+  ++(d->count);
+
+  return 1;
+}
+
+static int cmp_half_diag_entry(const void *a, const void *b)
+{
+  const half_diag_entry *x = a, *y = b;
+  if (x->sum != y->sum)
+    return x->sum < y->sum ? -1 : 1;
+  return 0;
+}
+
+static uint8_t join_half_diag(half_diags_data *d, uint64_t sum)
+{
+  perf_counter_tick(d->perf);
+  if (sum > d->target)
+    return 1;
+
+  const uint64_t key = d->target - sum;
+  size_t lo = 0, hi = d->count;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (d->table[mid].sum < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo < d->count && d->table[lo].sum == key)
+  {
+    d->match = d->table[lo].index;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * returns non-zero if a half over idx_a and one over idx_b add up to d->target
+ * in that case the items of the first one are at d->table_items + d->match * wa, the ones of the second in d->items
+ */
+static uint8_t join_half_diags(half_diags_data *d, const uint32_t *idx_a, uint32_t wa, const uint32_t *idx_b, uint32_t wb, half_diags_enumerator e)
+{
+  d->count = 0;
+  d->match = -1;
+
+  d->idx = idx_a;
+  d->width = wa;
+  d->table_width = wa;
+  d->used = 0;
+  (*e)(d, 0, 0, store_half_diag);
+  qsort(d->table, d->count, sizeof(half_diag_entry), cmp_half_diag_entry);
+
+  d->idx = idx_b;
+  d->width = wb;
+  d->used = 0;
+  (*e)(d, 0, 0, join_half_diag);
+
+  return d->match >= 0;
+}
+
+/*
+ * stage 1: permutes the lines inside of [0, n/2) and inside of [n/2, n), returns non-zero once diag1 is mu
+ */
+static uint8_t complete_diag1(half_diags_data *d, const uint32_t *idx, uint64_t mu)
+{
+  const pow_m_sqr M = d->M;
+  const uint32_t h = M.n / 2;
+
+  d->target = mu;
+  if (!join_half_diags(d, idx, h, idx + h, M.n - h, enumerate_half_line_perms))
+    return 0;
+
+  uint32_t old_rows[16];
+  memcpy(old_rows, M.rows, M.n * sizeof(*M.rows));
+  const uint8_t *first = d->table_items + d->match * h;
+  for (uint32_t l = 0; l < h; ++l)
+    M.rows[idx[l]] = old_rows[idx[first[l]]];
+  for (uint32_t l = 0; l < M.n - h; ++l)
+    M.rows[idx[h + l]] = old_rows[idx[h + d->items[l]]];
+
+  return 1;
+}
+
+/*
+ * stage 2: pairs the indices inside each half, the middle one stays in place if n is odd
+ * returns non-zero once diag2 is mu
+ */
+static uint8_t complete_diag2(half_diags_data *d, const uint32_t *idx, uint64_t mu)
+{
+  const pow_m_sqr M = d->M;
+  const uint32_t pairs = M.n / 2;
+  const uint32_t wa = 2 * (pairs / 2), wb = 2 * (pairs - pairs / 2);
+
+  // idx holds every index but the middle one
+  d->target = mu;
+  if (M.n % 2)
+  {
+    const uint32_t m = M.n / 2;
+    if (M_SQR_GET_POW_AS_MAT(M, m, m) > mu)
+      return 0;
+    d->target -= M_SQR_GET_POW_AS_MAT(M, m, m);
+  }
+
+  if (!join_half_diags(d, idx, wa, idx + wa, wb, enumerate_half_pairings))
+    return 0;
+
+  // the p-th pair (u, v) goes to the positions p and n - p - 1
+  uint32_t perm[16];
+  if (M.n % 2)
+    perm[M.n / 2] = M.n / 2;
+  const uint8_t *first = d->table_items + d->match * wa;
+  for (uint32_t p = 0; p < wa / 2; ++p)
+  {
+    perm[p] = idx[first[2 * p]];
+    perm[M.n - p - 1] = idx[first[2 * p + 1]];
+  }
+  for (uint32_t p = 0; p < wb / 2; ++p)
+  {
+    perm[wa / 2 + p] = idx[wa + d->items[2 * p]];
+    perm[M.n - wa / 2 - p - 1] = idx[wa + d->items[2 * p + 1]];
+  }
+
+  uint32_t old_rows[16], old_cols[16];
+  memcpy(old_rows, M.rows, M.n * sizeof(*M.rows));
+  memcpy(old_cols, M.cols, M.n * sizeof(*M.cols));
+  for (uint32_t k = 0; k < M.n; ++k)
+  {
+    M.rows[k] = old_rows[perm[k]];
+    M.cols[k] = old_cols[perm[k]];
+  }
+
+  return 1;
+}
+
+#define HALF_DIAGS_REFRESH_RATE (0xff)
+
+static void print_half_diags_progress(perf_counter *perf, int stage, size_t attempts, uint64_t curr, uint64_t mu)
+{
+#ifndef __NO_GUI__
+  clear();
+  move(0, 0);
+  printw("O(sqrt(mu)) method progress summary: (step %d)\n", stage);
+  printw("%zu attempts: %"PRIu64" != %"PRIu64"\n", attempts, curr, mu);
+  print_perfw(perf, "half diagonals");
+  refresh();
+#else
+  (void) perf;
+  printf("%d: %zu attempts: %"PRIu64" != %"PRIu64"\n", stage, attempts, curr, mu);
+#endif
+  return;
+}
+
+/*
+ * `M` is expected to contain a semi-magic square of powers, with n <= 16
+ * Is only likely to work if ((n/2)!)^2 / ( ((n/4)!)^2 * 2^(n/2) ) > mu
+ */
+void semi_to_full_meet_in_the_middle(perf_counter* perf, pow_m_sqr M)
+{
+  assert(M.n <= 16);
+
+  rng g = rng_split_global();
+  uint64_t mu = pow_m_sqr_sum_row(M, 0);
+  half_diags_data d = {.M = M, .perf = perf};
+
+  uint32_t idx[16];
+  for (uint32_t k = 0; k < M.n; ++k)
+    idx[k] = k;
+
+  size_t attempts = 0;
+  while (!complete_diag1(&d, idx, mu))
+  {
+    shuffle_lines(&g, M);
+    shuffle_cols(&g, M);
+    if ((++attempts & HALF_DIAGS_REFRESH_RATE) == 0)
+      print_half_diags_progress(perf, 1, attempts, pow_m_sqr_sum_diag1(M), mu);
+  }
+
+  // every index but the middle one is paired
+  if (M.n % 2)
+    for (uint32_t k = M.n / 2; k + 1 < M.n; ++k)
+      idx[k] = k + 1;
+
+  attempts = 0;
+  while (!complete_diag2(&d, idx, mu))
+  {
+    shuffle_lines_and_cols_with_same_perm(&g, M);
+    if ((++attempts & HALF_DIAGS_REFRESH_RATE) == 0)
+      print_half_diags_progress(perf, 2, attempts, pow_m_sqr_sum_diag2(M), mu);
+  }
+
+  free(d.table);
+  free(d.table_items);
+
+  return;
+}
+
 void generate_siamese(pow_m_sqr M)
 {
   for (uint64_t idx = 0; idx < M.n * M.n; ++idx)
@@ -745,6 +1198,8 @@ void generate_siamese(pow_m_sqr M)
     // getch();
   }
 
+  pow_m_sqr_update_pows(M);
+
   return;
 }
 
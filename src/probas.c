@@ -8,6 +8,7 @@
 
 #include "pow_m_sqr.h"
 #include "arithmetic.h"
+#include "rng.h"
 
 // doing factorial calculations
 #include "gmp.h"
@@ -54,7 +55,7 @@ uint64_t mod_pow(uint64_t base, uint64_t exp, uint64_t mod)
   return result;
 }
 
-double correction_factor(uint64_t p_e, uint64_t *arr, uint64_t d, uint64_t n, uint64_t m, uint64_t num_samples)
+double correction_factor(rng *g, uint64_t p_e, uint64_t *arr, uint64_t d, uint64_t n, uint64_t m, uint64_t num_samples)
 {
   const uint64_t modulus = p_e;
   uint64_t count_zero = 0;
@@ -65,7 +66,8 @@ double correction_factor(uint64_t p_e, uint64_t *arr, uint64_t d, uint64_t n, ui
 
     for (uint64_t i = 0; i < n; ++i)
     {
-      uint64_t x = rand() % n * n;
+      // uniform over the n * n entries
+      uint64_t x = rng_bounded(g, n * n);
 
       sum = (sum + mod_pow(arr[x], d, modulus)) % modulus;
     }
@@ -119,6 +121,7 @@ double coefficient_of_variation(uint64_t *arr, uint64_t n)
 
 double proba_without_latin_square(pow_m_sqr M)
 {
+  rng g = rng_split_global();
   const uint64_t n = M.n;
   const uint64_t m = pow_m_sqr_sum_row(M, 0);
   uint64_t *arr = calloc(n * n, sizeof(uint64_t));
@@ -129,7 +132,7 @@ double proba_without_latin_square(pow_m_sqr M)
   }
 
   for (uint64_t i = 0; i < n * n; ++i)
-    arr[i] = ui_pow_ui(M_SQR_GET_AS_VEC(M, i), M.d);
+    arr[i] = M_SQR_GET_POW_AS_VEC(M, i);
   const double c = coefficient_of_variation(arr, n * n);
   free(arr);
   // printf("c = %lf\n", c);
@@ -144,7 +147,7 @@ double proba_without_latin_square(pow_m_sqr M)
     {
       acc *= p;
     } while (acc * p <= lOCAL_BOUND);
-    double corr = correction_factor(acc, M.arr, M.d, n, m, NUM_SAMPLES);
+    double corr = correction_factor(&g, acc, M.arr, M.d, n, m, NUM_SAMPLES);
     f_mod *= corr;
   }
 
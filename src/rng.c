@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rng.h"
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/*
+ * expands the 64 bits seed into the 256 bits state, which is never all zero
+ */
+void rng_seed(rng *g, uint64_t seed)
+{
+  for (uint32_t i = 0; i < 4; ++i)
+    g->s[i] = splitmix64(&seed);
+  return;
+}
+
+/*
+ * equivalent to 2^128 calls to rng_next
+ */
+void rng_jump(rng *g)
+{
+  static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (uint32_t i = 0; i < sizeof(JUMP) / sizeof(*JUMP); ++i)
+    for (uint32_t b = 0; b < 64; ++b)
+    {
+      if (JUMP[i] & (1ULL << b))
+      {
+        s0 ^= g->s[0];
+        s1 ^= g->s[1];
+        s2 ^= g->s[2];
+        s3 ^= g->s[3];
+      }
+      (void) rng_next(g);
+    }
+
+  g->s[0] = s0;
+  g->s[1] = s1;
+  g->s[2] = s2;
+  g->s[3] = s3;
+
+  return;
+}
+
+static rng global_rng = {.s = {0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL, 0x94d049bb133111ebULL, 1}};
+static pthread_mutex_t global_rng_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void rng_seed_global(uint64_t seed)
+{
+  pthread_mutex_lock(&global_rng_mutex);
+  rng_seed(&global_rng, seed);
+  pthread_mutex_unlock(&global_rng_mutex);
+  return;
+}
+
+rng rng_split_global(void)
+{
+  pthread_mutex_lock(&global_rng_mutex);
+  rng ret = global_rng;
+  rng_jump(&global_rng);
+  pthread_mutex_unlock(&global_rng_mutex);
+  return ret;
+}
@@ -10,6 +10,7 @@
 #include "types.h"
 #include "serialize.h"
 #include "pow_m_sqr.h"
+#include "permut.h"
 #include "taxicab_method_common.h"
 #include "find_latin_squares.h"
 #include "probas.h"
@@ -199,7 +200,8 @@ void fread_pow_m_sqr(FILE* f, pow_m_sqr* M)
   M->rows = calloc(M->n, sizeof(*M->rows));
   M->cols = calloc(M->n, sizeof(*M->cols));
   M->arr = calloc(M->n * M->n, sizeof(*M->arr));
-  if (M->arr == NULL || M->cols == NULL || M->rows == NULL)
+  M->pows = calloc(M->n * M->n, sizeof(*M->pows));
+  if (M->arr == NULL || M->pows == NULL || M->cols == NULL || M->rows == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
@@ -207,6 +209,7 @@ void fread_pow_m_sqr(FILE* f, pow_m_sqr* M)
   fread(M->rows, sizeof(*M->rows),  M->n,       f);
   fread(M->cols, sizeof(*M->cols), M->n,       f);
   fread(M->arr,  sizeof(*M->arr),  M->n * M->n, f);
+  pow_m_sqr_update_pows(*M);
   return;
 }
 
@@ -397,12 +400,26 @@ void save_rels(const char* const base_file_name, da_sets rels, const char* const
   return;
 }
 
+/*
+ * appends the rels of the file to rels, every one is allocated as done by the set searches
+ */
 void fread_rels(FILE* f, da_sets* rels)
 {
+  size_t count = 0;
   fread(&rels->n, sizeof(rels->n), 1, f);
-  fread(&rels->count, sizeof(rels->count), 1, f);
-  for (size_t i = 0; i < rels->count; ++i)
-    fread(rels->items[i], sizeof(*rels->items[i]), rels->n, f);
+  fread(&count, sizeof(count), 1, f);
+  for (size_t i = 0; i < count; ++i)
+  {
+    rel_item *set = calloc(rels->n, sizeof(rel_item));
+    if (set == NULL)
+    {
+      fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+      exit(1);
+    }
+
+    fread(set, sizeof(*set), rels->n, f);
+    da_append(rels, set);
+  }
   return;
 }
 
@@ -594,6 +611,11 @@ void load_latin_squares(const char*const base_file_name, latin_square** P, uint3
  *  size_t   uint32_t   uint32_t    array of N arrys of latin_squares contents
  *  there r Ps each of size sxs
  *  and s Qs each of size rxr
+ *
+ * companion .latin_square_inv format, in the same order:
+ * [   N   ][    r    ][    s    ][     [   P_map, Q_map   ], ...,          ]
+ *  size_t   uint32_t   uint32_t    array of N latin_squares_inv maps
+ *  P_map has r*s*s uint8_ts and Q_map s*r*r, see latin_squares_inv in types.h
  */
 
 static uint8_t callback2(latin_square *_1, uint64_t _2, void *data);
@@ -615,17 +637,33 @@ static uint8_t callback2(latin_square *_1, uint64_t _2, void *data)
   for (uint32_t j = 0; j < pack->s; ++j)
     fwrite(pack->Q[j].arr, sizeof(*pack->Q[j].arr), pack->r*pack->r, pack->f);
 
+  if (pack->f_inv != NULL)
+  {
+    latin_squares_inv_compute(&pack->ls_inv, pack->P, pack->Q, pack->r, pack->s);
+    fwrite(pack->ls_inv.P_map, sizeof(*pack->ls_inv.P_map), pack->r*pack->s*pack->s, pack->f_inv);
+    fwrite(pack->ls_inv.Q_map, sizeof(*pack->ls_inv.Q_map), pack->s*pack->r*pack->r, pack->f_inv);
+  }
+
   return 1;
 }
 
-void fwrite_all_latin_square_arrays(FILE* f, latin_square* P, latin_square* Q, uint32_t r, uint32_t s)
+/*
+ * f_inv can be NULL, otherwise the companion file is written along
+ */
+void fwrite_all_latin_square_arrays(FILE* f, FILE* f_inv, latin_square* P, latin_square* Q, uint32_t r, uint32_t s)
 {
-  iterate_over_latin_squares_array_pack pack = {.P = P, .Q = Q, .r = r, .s = s, .f = f};
+  iterate_over_latin_squares_array_pack pack = {.P = P, .Q = Q, .r = r, .s = s, .f = f, .f_inv = f_inv};
 
   size_t count = number_of_latin_squares(r, s);
   fwrite(&count, sizeof(count), 1, f);
   fwrite(&r, sizeof(r), 1, f);
   fwrite(&s, sizeof(s), 1, f);
+  if (f_inv != NULL)
+  {
+    fwrite(&count, sizeof(count), 1, f_inv);
+    fwrite(&r, sizeof(r), 1, f_inv);
+    fwrite(&s, sizeof(s), 1, f_inv);
+  }
   iterate_over_all_square_array_callback(P, r, callback1, &pack);
 
   return;
@@ -634,15 +672,17 @@ void fwrite_all_latin_square_arrays(FILE* f, latin_square* P, latin_square* Q, u
 void save_all_latin_square_arrays(const char*const base_file_name, latin_square* P, latin_square* Q, uint32_t r, uint32_t s, const char*const name)
 {
   FILE* f = fopen(FNAME(base_file_name, name, ".latin_square"), "w");
-  if (f == NULL)
+  FILE* f_inv = fopen(FNAME(base_file_name, name, ".latin_square_inv"), "w");
+  if (f == NULL || f_inv == NULL)
   {
     fprintf(stderr, "[ERROR] Could not read file: %s\n", strerror(errno));
     exit(1);
   }
 
-  fwrite_all_latin_square_arrays(f, P, Q, r, s);
+  fwrite_all_latin_square_arrays(f, f_inv, P, Q, r, s);
 
   fclose(f);
+  fclose(f_inv);
 
   return;
 }
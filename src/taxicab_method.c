@@ -21,64 +21,55 @@ void print_iterate_over_latin_squares_array_pack(iterate_over_latin_squares_arra
 
 /*
  * returns non-zero to indicate to continue
- * mark stores rels which have already fallen on different lines before
+ * the rels which fall on different lines are mapped through the array once, into pack->mapped,
+ * each one is then tested against the ones before it in the buffer
  */
-uint8_t check_for_compatibility_in_latin_squares(latin_square *P, const uint32_t r, latin_square *Q, const uint32_t s, void* data)
+uint8_t check_for_compatibility_in_latin_squares(latin_square *P, const uint32_t r, latin_square *Q, const uint32_t s, const latin_squares_inv *ls_inv, void* data)
 {
   const uint64_t n = r * s;
 
   iterate_over_latin_squares_array_pack* pack = data;
   da_sets rels = pack->rels;
-  da_sets mark = pack->mark;
   pow_m_sqr* M = pack->M;
   uint8_t* rows = pack->rows;
   uint8_t* cols = pack->cols;
-  x_y_rel rel1 = pack->rel1;
-  x_y_rel rel2 = pack->rel2;
+  x_y_rel mapped = pack->mapped;
+  uint32_t* mapped_rels = pack->mapped_rels;
+  uint64_t* packed = pack->packed;
   x_y_rel inv = pack->inv;
   x_y_rel sigma = pack->sigma;
 
-  da_foreach(rel_item *, rel, &rels)
+  // the rels are all mapped through the same array: look up the latin squares once, unless it was done at -regen
+  if (ls_inv == NULL)
   {
+    latin_squares_inv_compute(&pack->ls_inv, P, Q, r, s);
+    ls_inv = &pack->ls_inv;
+  }
+
+  size_t mapped_count = 0;
+  for (size_t k = 0; k < rels.count; ++k)
+  {
+    rel_item** rel = rels.items + k;
+    x_y_rel rel1 = mapped + mapped_count * n;
+
     memset(rows, 0, sizeof(*rows) * n);
     memset(cols, 0, sizeof(*cols) * n);
-    if (!fall_on_different_line_after_latin_squares(rows, cols,*rel, P, Q, r, s))
+    if (!x_y_rel_after_latin_squares_inv_checked(rel1, rows, cols, *rel, ls_inv))
       continue;
 
-    x_y_rel_after_latin_squares(rel1, *rel, P, Q, r, s);
+    uint64_t* words1 = packed + mapped_count * PACKED_X_Y_REL_WORDS;
+    pack_x_y_rel(words1, rel1, n);
 
-    da_foreach(rel_item *, prev_rel, &mark)
+    for (size_t l = 0; l < mapped_count; ++l)
     {
-      x_y_rel_after_latin_squares(rel2, *prev_rel, P, Q, r, s);
-
-      // Check if the two transformed rels still fall on different rows/cols
-      memset(rows, 0, sizeof(*rows) * n);
-      memset(cols, 0, sizeof(*cols) * n);
-
-      // Mark rows/cols used by rel1
-      for (uint64_t i = 0; i < n; ++i)
-      {
-        rows[i] = 1;
-        cols[rel1[i]] = 1;
-      }
-
-      // Check if rel2 collides
-      uint8_t collision = 0;
-      for (uint64_t i = 0; i < n; ++i)
-      {
-        if (rows[i] || cols[rel2[i]])
-        {
-          collision = 1;
-          break;
-        }
-      }
-
-      if (collision)
-        continue; // These two sets collide after transformation, skip
+      rel_item** prev_rel = rels.items + mapped_rels[l];
+      if (!packed_x_y_rels_are_disjoint(words1, packed + l * PACKED_X_Y_REL_WORDS, n))
+        continue; // These two sets share a cell after transformation, skip
 
       memset(inv, 0, n * sizeof(*inv));
       memset(sigma, 0, n * sizeof(*inv));
 
+      x_y_rel rel2 = mapped + l * n;
       if (!rels_are_diagonizable(rel1, rel2, inv, sigma, n))
         continue;
 
@@ -115,7 +106,7 @@ uint8_t check_for_compatibility_in_latin_squares(latin_square *P, const uint32_t
       return 0; // quit the search
     }
 
-    da_append(&mark, *rel);
+    mapped_rels[mapped_count++] = k;
   }
 
   return 1;
@@ -125,13 +116,16 @@ uint8_t find_set_compatible_latin_squares_array(const char* const base_file_name
 {
   const size_t n = M->n;
 
-  iterate_over_latin_squares_array_pack pack = {.M = M, .rels = rels, .mark = mark, .perf = perf};
+  UNUSED(mark);
 
-  pack.rel1 = calloc(n, sizeof(rel_item));
-  pack.rel2 = calloc(n, sizeof(rel_item));
+  iterate_over_latin_squares_array_pack pack = {.M = M, .rels = rels, .perf = perf};
+
+  pack.mapped = calloc(rels.count * n, sizeof(rel_item));
+  pack.mapped_rels = calloc(rels.count, sizeof(uint32_t));
+  pack.packed = calloc(rels.count * PACKED_X_Y_REL_WORDS, sizeof(uint64_t));
   pack.inv = calloc(n, sizeof(rel_item));
   pack.sigma = calloc(n, sizeof(rel_item));
-  if (pack.rel1 == NULL || pack.rel2 == NULL || pack.inv == NULL || pack.sigma == NULL)
+  if (pack.mapped == NULL || pack.mapped_rels == NULL || pack.packed == NULL || pack.inv == NULL || pack.sigma == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
@@ -147,8 +141,9 @@ uint8_t find_set_compatible_latin_squares_array(const char* const base_file_name
 
   uint8_t ret = action_on_all_latin_square_arrays(base_file_name, name, perf, check_for_compatibility_in_latin_squares, &pack);
 
-  free(pack.rel1);
-  free(pack.rel2);
+  free(pack.mapped);
+  free(pack.mapped_rels);
+  free(pack.packed);
   free(pack.inv);
   free(pack.sigma);
   free(pack.rows);
@@ -165,7 +160,12 @@ typedef struct
   pow_m_sqr_and_da_sets_packed* data;
 } find_sets_collision_method_pack;
 
-void search_pow_m_sqr_from_taxicabs(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets)
+/*
+ * the sets found are logged in base_file_name, and the tables of the collision method saved there if snapshot is set
+ * with prefill, its prefilled tables are kept in SETS_PREFILL_DIR for the next runs on M
+ * with join, the sets are found by the batched join instead of the collision method
+ */
+void search_pow_m_sqr_from_taxicabs(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, uint8_t exhaustive, uint8_t join, uint8_t snapshot, uint8_t prefill)
 {
   assert(a.r == b.s && a.s == b.r);
   assert(a.d == b.d);
@@ -187,10 +187,20 @@ void search_pow_m_sqr_from_taxicabs(perf_counter* perf, const char* const base_f
     requiered_sets = REQUIERED_SETS;
   }
 
+  char log_file[512], snapshot_file[512], checkpoint_file[512];
+  snprintf(log_file, sizeof(log_file), "%s%s", base_file_name, SETS_LOG_NAME);
+  snprintf(snapshot_file, sizeof(snapshot_file), "%s%s", base_file_name, SETS_SNAPSHOT_NAME);
+  snprintf(checkpoint_file, sizeof(checkpoint_file), "%s%s", base_file_name, SETS_CHECKPOINT_NAME);
+
   da_sets rels = {.n = M.n};
   pow_m_sqr_and_da_sets_packed pack = {.M = &M, .rels = &rels, .requiered_sets=requiered_sets};
 #if 1
-  find_sets_collision_method(M, a.r, a.s, requiered_sets, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  if (exhaustive)
+    find_sets_meet_in_the_middle(M, a.r, a.s, checkpoint_file, 0, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  else if (join)
+    find_sets_join_method(M, a.r, a.s, requiered_sets, log_file, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  else
+    find_sets_collision_method(M, a.r, a.s, requiered_sets, log_file, snapshot ? snapshot_file : NULL, prefill ? SETS_PREFILL_DIR : NULL, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
 #else
   iterate_over_sets_callback(a.r, a.s, search_pow_m_sqr_from_taxicab_iterate_over_sets_callback, &pack);
 #endif
@@ -50,7 +50,7 @@ uint8_t search_pow_m_sqr_from_taxicab_find_sets_collision_callback(uint8_t *sele
       if (GET_AS_MAT(selected, i, j, n))
       {
         set[k++] = i * n + j;
-        acc += ui_pow_ui(M_SQR_GET_AS_MAT(*pack->M, i, j), pack->M->d);
+        acc += M_SQR_GET_POW_AS_MAT(*pack->M, i, j);
       }
 #ifndef __NO_GUI__
   printw("  *");
@@ -22,71 +22,75 @@ void print_iterate_over_latin_squares_array_pack(iterate_over_latin_squares_arra
 
 /*
  * returns non-zero to indicate to continue
- * mark stores rels which have already fallen on different lines before
+ * the rels which fall on different lines are mapped through the array once, into pack->mapped,
+ * each one is then tested against the ones before it in the buffer
  */
-uint8_t check_for_compatibility_in_latin_squares_mt(latin_square *P, const uint32_t r, latin_square *Q, const uint32_t s, void* data)
+static uint8_t check_for_compatibility_in_array_mt(iterate_over_latin_squares_array_pack* pack, const latin_squares_inv *ls_inv, const uint64_t n)
 {
-  const uint64_t n = r * s;
-
-  iterate_over_latin_squares_array_pack* pack = data;
   da_sets rels = pack->rels;
-  da_sets mark = pack->mark;
   // pow_m_sqr* M = pack->M;
   uint8_t* rows = pack->rows;
   uint8_t* cols = pack->cols;
-  x_y_rel rel1 = pack->rel1;
-  x_y_rel rel2 = pack->rel2;
+  x_y_rel mapped = pack->mapped;
+  uint32_t* mapped_rels = pack->mapped_rels;
+  uint64_t* packed = pack->packed;
   x_y_rel inv = pack->inv;
   x_y_rel sigma = pack->sigma;
 
-  da_foreach(rel_item *, rel, &rels)
+  size_t mapped_count = 0;
+  for (size_t k = 0; k < rels.count; ++k)
   {
+    rel_item** rel = rels.items + k;
+    x_y_rel rel1 = mapped + mapped_count * n;
+
     memset(rows, 0, sizeof(*rows) * n);
     memset(cols, 0, sizeof(*cols) * n);
-    if (!fall_on_different_line_after_latin_squares(rows, cols,*rel, P, Q, r, s))
+    if (!x_y_rel_after_latin_squares_inv_checked(rel1, rows, cols, *rel, ls_inv))
       continue;
 
-    x_y_rel_after_latin_squares(rel1, *rel, P, Q, r, s);
+    uint64_t* words1 = packed + mapped_count * PACKED_X_Y_REL_WORDS;
+    pack_x_y_rel(words1, rel1, n);
 
-    da_foreach(rel_item *, prev_rel, &mark)
+    for (size_t l = 0; l < mapped_count; ++l)
     {
-      x_y_rel_after_latin_squares(rel2, *prev_rel, P, Q, r, s);
-
-      // Check if the two transformed rels still fall on different rows/cols
-      memset(rows, 0, sizeof(*rows) * n);
-      memset(cols, 0, sizeof(*cols) * n);
-
-      // Mark rows/cols used by rel1
-      for (uint64_t i = 0; i < n; ++i)
-      {
-        rows[i] = 1;
-        cols[rel1[i]] = 1;
-      }
-
-      // Check if rel2 collides
-      uint8_t collision = 0;
-      for (uint64_t i = 0; i < n; ++i)
-      {
-        if (rows[i] || cols[rel2[i]])
-        {
-          collision = 1;
-          break;
-        }
-      }
-
-      if (collision)
-        continue; // These two sets collide after transformation, skip
+      if (!packed_x_y_rels_are_disjoint(words1, packed + l * PACKED_X_Y_REL_WORDS, n))
+        continue; // These two sets share a cell after transformation, skip
 
       memset(inv, 0, n * sizeof(*inv));
       memset(sigma, 0, n * sizeof(*inv));
 
+      x_y_rel rel2 = mapped + l * n;
       if (!rels_are_diagonizable(rel1, rel2, inv, sigma, n))
         continue;
 
       return 0; // quit the search
     }
 
-    da_append(&mark, *rel);
+    mapped_rels[mapped_count++] = k;
+  }
+
+  return 1;
+}
+
+/*
+ * returns non-zero to indicate to continue
+ * goes through count arrays, as laid out in the .latin_square file
+ */
+uint8_t check_for_compatibility_in_latin_squares_mt(const uint8_t *arrays, const uint8_t *inv_maps, size_t count, const uint32_t r, const uint32_t s, void* data)
+{
+  iterate_over_latin_squares_array_pack* pack = data;
+  const size_t array_size = r * s*s + s * r*r;
+
+  for (size_t k = 0; k < count; ++k)
+  {
+    // the rels are all mapped through the same array: look up the latin squares once, unless it was done at -regen
+    if (inv_maps != NULL)
+      latin_squares_inv_from_maps(&pack->ls_inv, inv_maps + k * array_size, r, s);
+    else
+      latin_squares_inv_compute_from_array(&pack->ls_inv, arrays + k * array_size, r, s);
+
+    if (!check_for_compatibility_in_array_mt(pack, &pack->ls_inv, r * s))
+      return 0;
   }
 
   return 1;
@@ -112,15 +116,15 @@ void* init_pack(void* arg)
 
   pack->M     = M;
   pack->rels  = rels; // rels is read only
-  pack->mark  = (da_sets){0};
   pack->perf  = calloc(1, sizeof(perf_counter)); // zero initialize
   perf_counter_init(pack->perf, perf->lspeed_window);
   perf->counter = 69420ULL;
-  pack->rel1  = calloc(n, sizeof(rel_item));
-  pack->rel2  = calloc(n, sizeof(rel_item));
-  pack->inv   = calloc(n, sizeof(rel_item));
-  pack->sigma = calloc(n, sizeof(rel_item));
-  if (pack->rel1 == NULL || pack->rel2 == NULL || pack->inv == NULL || pack->sigma == NULL)
+  pack->mapped      = calloc(rels.count * n, sizeof(rel_item));
+  pack->mapped_rels = calloc(rels.count, sizeof(uint32_t));
+  pack->packed      = calloc(rels.count * PACKED_X_Y_REL_WORDS, sizeof(uint64_t));
+  pack->inv         = calloc(n, sizeof(rel_item));
+  pack->sigma       = calloc(n, sizeof(rel_item));
+  if (pack->mapped == NULL || pack->mapped_rels == NULL || pack->packed == NULL || pack->inv == NULL || pack->sigma == NULL)
   {
     fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
     exit(1);
@@ -141,8 +145,9 @@ void clear_pack(void* data)
 {
   iterate_over_latin_squares_array_pack* pack = data;
 
-  free(pack->rel1);
-  free(pack->rel2);
+  free(pack->mapped);
+  free(pack->mapped_rels);
+  free(pack->packed);
   free(pack->inv);
   free(pack->sigma);
   free(pack->rows);
@@ -152,7 +157,10 @@ void clear_pack(void* data)
   return;
 }
 
-uint8_t find_set_compatible_latin_squares_array_mt(const char* const base_file_name, const char* const name, pow_m_sqr *M, da_sets rels, da_sets mark, perf_counter* perf, size_t thread_count)
+/*
+ * the scan of the arrays is checkpointed to checkpoint_file, and resumed from it, if it is not NULL
+ */
+uint8_t find_set_compatible_latin_squares_array_mt(const char* const base_file_name, const char* const name, pow_m_sqr *M, da_sets rels, da_sets mark, perf_counter* perf, size_t thread_count, size_t chunk_size, uint32_t r, uint32_t s, uint8_t stream, const char* const checkpoint_file)
 {
   UNUSED(mark);
 
@@ -162,7 +170,12 @@ uint8_t find_set_compatible_latin_squares_array_mt(const char* const base_file_n
     .rels = rels,
   };
 
-  uint8_t ret = action_on_all_latin_square_arrays_mt(base_file_name, name, thread_count, perf, check_for_compatibility_in_latin_squares_mt, init_pack, clear_pack, &pack);
+  // both give the arrays in the same order, a checkpoint of one can be resumed with the other
+  const uint64_t tag = latin_square_checkpoint_tag(rels);
+
+  // r and s are only needed to generate the arrays, the file holds them otherwise
+  uint8_t ret = stream ? action_on_all_generated_latin_square_arrays_mt(r, s, thread_count, chunk_size, checkpoint_file, tag, perf, check_for_compatibility_in_latin_squares_mt, init_pack, clear_pack, &pack)
+                       : action_on_all_latin_square_arrays_mt(base_file_name, name, thread_count, chunk_size, checkpoint_file, tag, perf, check_for_compatibility_in_latin_squares_mt, init_pack, clear_pack, &pack);
 
   return ret;
 }
@@ -175,7 +188,15 @@ typedef struct
   pow_m_sqr_and_da_sets_packed* data;
 } find_sets_collision_method_pack;
 
-void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, size_t thread_count)
+/*
+ * the sets found are logged in base_file_name, and the tables of the collision method saved there if snapshot is set
+ * with prefill, its prefilled tables are kept in SETS_PREFILL_DIR for the next runs on M
+ * the scan of the arrays is checkpointed there as well
+ * with resume, the rels are read back from there if the set search was over, otherwise it goes on from the log and the
+ * snapshot, and the scan picks up from the checkpoint
+ * with join, the sets are found by the batched join instead of the collision method, on a single thread
+ */
+void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const base_file_name, pow_m_sqr M, taxicab a, taxicab b, size_t requiered_sets, size_t thread_count, size_t chunk_size, uint8_t exhaustive, uint8_t join, uint8_t stream, uint8_t resume, uint8_t snapshot, uint8_t prefill)
 {
   assert(a.r == b.s && a.s == b.r);
   assert(a.d == b.d);
@@ -197,10 +218,25 @@ void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const bas
     requiered_sets = REQUIERED_SETS;
   }
 
+  char log_file[512], snapshot_file[512], sets_checkpoint_file[512];
+  snprintf(log_file, sizeof(log_file), "%s%s", base_file_name, SETS_LOG_NAME);
+  snprintf(snapshot_file, sizeof(snapshot_file), "%s%s", base_file_name, SETS_SNAPSHOT_NAME);
+  snprintf(sets_checkpoint_file, sizeof(sets_checkpoint_file), "%s%s", base_file_name, SETS_CHECKPOINT_NAME);
+
+  // the rels are only saved once the set search is over
+  const uint8_t sets_done = resume && file_exists(temp_sprintf("%srels.rels", base_file_name)) == 1;
+
   da_sets rels = {.n = M.n};
   pow_m_sqr_and_da_sets_packed pack = {.M = &M, .rels = &rels, .requiered_sets=requiered_sets};
 #if 1
-  find_sets_collision_method(M, a.r, a.s, requiered_sets, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  if (sets_done)
+    load_rels(base_file_name, &rels, "rels");
+  else if (exhaustive)
+    find_sets_meet_in_the_middle(M, a.r, a.s, sets_checkpoint_file, resume, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  else if (join)
+    find_sets_join_method(M, a.r, a.s, requiered_sets, log_file, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
+  else
+    find_sets_collision_method_mt(M, a.r, a.s, requiered_sets, thread_count, log_file, snapshot ? snapshot_file : NULL, prefill ? SETS_PREFILL_DIR : NULL, perf, search_pow_m_sqr_from_taxicab_find_sets_collision_callback, &pack);
 #else
   iterate_over_sets_callback(a.r, a.s, search_pow_m_sqr_from_taxicab_iterate_over_sets_callback, &pack);
 #endif
@@ -227,7 +263,8 @@ void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const bas
     return;
   }
 
-  save_rels(base_file_name, rels, "rels");
+  if (!sets_done)
+    save_rels(base_file_name, rels, "rels");
 
   // arrays holding the latin squares
   latin_square *P = calloc(a.r, sizeof(latin_square));
@@ -246,8 +283,11 @@ void search_pow_m_sqr_from_taxicabs_mt(perf_counter* perf, const char* const bas
   perf_counter_clear(perf);
   perf_counter_init(perf, 1);
 
+  char checkpoint_file[512];
+  snprintf(checkpoint_file, sizeof(checkpoint_file), "%s%s", base_file_name, LATIN_SQUARE_CHECKPOINT_NAME);
+
   da_sets mark = {.n = M.n};
-  int res = find_set_compatible_latin_squares_array_mt("./", "squares", &M, rels, mark, perf, thread_count);
+  int res = find_set_compatible_latin_squares_array_mt("./", "squares", &M, rels, mark, perf, thread_count, chunk_size, a.r, a.s, stream, checkpoint_file);
 
   save_latin_squares(base_file_name, P, a.r, Q, a.s, "arrays");
 
@@ -0,0 +1,204 @@
+/*
+ * microbenchmark of the partial set tables used by the collision method:
+ * the single threaded hshtbl against the lock-free lf_hshtbl with 1 up to `threads` threads
+ *
+ * build from the repo root, after building the objects with nob:
+ *   gcc -O3 -pthread -Iinclude -I. src/test/bench_hshtbl.c src/obj/hshtbl.o -o bin/bench_hshtbl -lm
+ * usage: bench_hshtbl [entries] [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hshtbl.h"
+#include "timer.h"
+
+#define N (12)     // side of the square
+#define WIDTH (5)  // size of the partial sets, the biggest tables for a 12x12 square hold 6
+#define LOOKUPS_PER_INSERT (4)
+
+typedef struct
+{
+  rel_item *items;   // WIDTH items per entry, sorted
+  uint8_t *selected; // N*N per entry
+  uint64_t *sums;
+} workload;
+
+/*
+ * random partial sets, the sum of the cubes of the positions gives sums colliding about as often as the real ones
+ */
+workload make_workload(size_t count)
+{
+  workload w = {
+    .items = calloc(count * WIDTH, sizeof(rel_item)),
+    .selected = calloc(count * N * N, sizeof(uint8_t)),
+    .sums = calloc(count, sizeof(uint64_t)),
+  };
+  if (w.items == NULL || w.selected == NULL || w.sums == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint8_t *selected = w.selected + i * N * N;
+    for (uint32_t k = 0; k < WIDTH;)
+    {
+      const uint32_t pos = rand() % (N * N);
+      if (selected[pos])
+        continue;
+      selected[pos] = 1;
+      ++k;
+    }
+
+    for (uint32_t pos = 0, k = 0; pos < N * N; ++pos)
+      if (selected[pos])
+      {
+        w.items[i * WIDTH + k++] = pos;
+        w.sums[i] += (uint64_t)(pos + 1) * (pos + 1) * (pos + 1);
+      }
+  }
+
+  return w;
+}
+
+void free_workload(workload w)
+{
+  free(w.items);
+  free(w.selected);
+  free(w.sums);
+  return;
+}
+
+/*
+ * same loop as check_if_set_can_be_formed_from_collision: walk the whole probe chain, touch the matching items
+ */
+size_t hshtbl_lookup(const hshtbl *table, const uint64_t key)
+{
+  size_t acc = 0;
+  for (uint32_t h = hash_func(key) % table->capacity; table->arr[h].item; h = (h + 1) % table->capacity)
+    if (table->arr[h].sum == key)
+      acc += HSHTBL_NODE_ITEMS(table, table->arr[h])[0];
+  return acc;
+}
+
+size_t lf_hshtbl_lookup(const lf_hshtbl *table, const uint64_t key)
+{
+  size_t acc = 0;
+  for (int64_t h = lf_hshtbl_find_next(table, key, -1); h >= 0; h = lf_hshtbl_find_next(table, key, h))
+    acc += LF_HSHTBL_SLOT_ITEMS(table, h)[0];
+  return acc;
+}
+
+double bench_hshtbl(const workload *w, const size_t count, size_t *acc)
+{
+  hshtbl table;
+  init_hshtbl(&table, WIDTH);
+
+  timer t;
+  timer_start(&t);
+  for (size_t i = 0; i < count; ++i)
+  {
+    hshtbl_insert(&table, w->items + i * WIDTH, w->selected + i * N * N, WIDTH, w->sums[i], N);
+    for (size_t l = 0; l < LOOKUPS_PER_INSERT; ++l)
+      *acc += hshtbl_lookup(&table, w->sums[(i * LOOKUPS_PER_INSERT + l) % count]);
+  }
+  const double elapsed = timer_stop(&t);
+
+  free_hshtbl(&table);
+  return elapsed;
+}
+
+typedef struct
+{
+  pthread_t id;
+  lf_hshtbl *table;
+  const workload *w;
+  size_t count, begin, end;
+  size_t acc;
+} lf_worker_data;
+
+void *lf_worker(void *arg)
+{
+  lf_worker_data *d = (lf_worker_data*)arg;
+  for (size_t i = d->begin; i < d->end; ++i)
+  {
+    lf_hshtbl_insert(d->table, d->w->items + i * WIDTH, d->w->selected + i * N * N, WIDTH, d->w->sums[i], N);
+    for (size_t l = 0; l < LOOKUPS_PER_INSERT; ++l)
+      d->acc += lf_hshtbl_lookup(d->table, d->w->sums[(i * LOOKUPS_PER_INSERT + l) % d->count]);
+  }
+  return NULL;
+}
+
+double bench_lf_hshtbl(const workload *w, const size_t count, const size_t thread_count, size_t *acc)
+{
+  size_t capacity = 1;
+  while (capacity * HSHTBL_MAX_FULLNESS_RATIO <= count)
+    capacity *= 2;
+
+  lf_hshtbl table;
+  init_lf_hshtbl(&table, WIDTH, capacity);
+
+  lf_worker_data *workers = calloc(thread_count, sizeof(lf_worker_data));
+  if (workers == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  timer t;
+  timer_start(&t);
+  for (size_t k = 0; k < thread_count; ++k)
+  {
+    workers[k] = (lf_worker_data) {
+      .table = &table, .w = w, .count = count,
+      .begin = count * k / thread_count, .end = count * (k + 1) / thread_count,
+    };
+    pthread_create(&workers[k].id, NULL, lf_worker, workers + k);
+  }
+  for (size_t k = 0; k < thread_count; ++k)
+  {
+    pthread_join(workers[k].id, NULL);
+    *acc += workers[k].acc;
+  }
+  const double elapsed = timer_stop(&t);
+
+  free(workers);
+  free_lf_hshtbl(&table);
+  return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+  const size_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 4 * 1024 * 1024;
+  const size_t max_threads = argc > 2 ? strtoull(argv[2], NULL, 10) : 4;
+
+  srand(42);
+  workload w = make_workload(count);
+  size_t acc = 0;
+
+  printf("%zu inserts of %u items, %u lookups each\n", count, WIDTH, LOOKUPS_PER_INSERT);
+
+  const double base = bench_hshtbl(&w, count, &acc);
+  printf("hshtbl              : %.3fs, %.2f Mops/s\n", base, count / base / 1e6);
+
+  for (size_t t = 1; t <= max_threads; t *= 2)
+  {
+    const double elapsed = bench_lf_hshtbl(&w, count, t, &acc);
+    printf("lf_hshtbl %2zu threads: %.3fs, %.2f Mops/s, x%.2f\n", t, elapsed, count / elapsed / 1e6, base / elapsed);
+  }
+
+  // keep the lookups from being optimized away
+  fprintf(stderr, "checksum: %zu\n", acc);
+
+  free_workload(w);
+  return 0;
+}
+
+#define NOB_IMPLEMENTATION
+#include "nob.h"
+#define __TIMER_IMPLEMENTATION__
+#include "timer.h"
@@ -0,0 +1,148 @@
+/*
+ * microbenchmark of the mapping of the rels through an array of latin squares, as done by
+ * check_for_compatibility_in_latin_squares on the 3x4 enumeration:
+ * position_after_latin_square_permutation (scans the rows of P[j] and Q[i] for every cell) against
+ * position_after_latin_square_permutation_inv (two loads from the tables built once per array)
+ *
+ * build from the repo root, after building the objects with nob:
+ *   gcc -O3 -pthread -Iinclude -I. src/test/bench_latin_squares_inv.c <the objects of src/obj but main and viewer> \
+ *     -o bin/bench_latin_squares_inv -lm -lncurses -lgmp
+ * usage: bench_latin_squares_inv [arrays] [rels]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "types.h"
+#include "permut.h"
+#include "pow_m_sqr.h"
+#include "find_latin_squares.h"
+#include "rng.h"
+#include "timer.h"
+
+#define R (3)
+#define S (4)
+#define N (R * S)
+
+/*
+ * the i-th array of the enumeration, in mixed radix over the lists
+ */
+void nth_array(latin_square *P, latin_square *Q, size_t idx, const latin_square_list *Ps, const latin_square_list *Qs)
+{
+  for (uint32_t j = 0; j < R; ++j)
+  {
+    P[j] = (latin_square){.n = S, .arr = Ps->arr + (idx % Ps->count) * S * S};
+    idx /= Ps->count;
+  }
+  for (uint32_t i = 0; i < S; ++i)
+  {
+    Q[i] = (latin_square){.n = R, .arr = Qs->arr + (idx % Qs->count) * R * R};
+    idx /= Qs->count;
+  }
+  return;
+}
+
+/*
+ * rels with one entry per row and per column, like the ones found by the set searches
+ */
+rel_item *random_rels(rng *g, size_t count)
+{
+  rel_item *rels = calloc(count * N, sizeof(rel_item));
+  if (rels == NULL)
+  {
+    fprintf(stderr, "[OOM] Buy more RAM LOL!!\n");
+    exit(1);
+  }
+
+  rel_item perm[N];
+  for (size_t k = 0; k < count; ++k)
+  {
+    for (uint32_t i = 0; i < N; ++i)
+      perm[i] = i;
+    for (uint32_t i = N - 1; i > 0; --i)
+    {
+      const uint32_t j = rng_bounded(g, i + 1);
+      const rel_item t = perm[j];
+      perm[j] = perm[i];
+      perm[i] = t;
+    }
+    for (uint32_t i = 0; i < N; ++i)
+      rels[k * N + i] = i * N + perm[i];
+  }
+
+  return rels;
+}
+
+int main(int argc, char **argv)
+{
+  const size_t array_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+  const size_t rel_count = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+
+  const latin_square_list *Ps = latin_square_table(S);
+  const latin_square_list *Qs = latin_square_table(R);
+
+  rng g;
+  rng_seed(&g, 42);
+  rel_item *rels = random_rels(&g, rel_count);
+
+  latin_square P[R], Q[S];
+  uint8_t rows[N], cols[N];
+  rel_item mapped[N];
+  size_t acc_scan = 0, acc_inv = 0;
+
+  printf("%zu arrays of the %ux%u enumeration, %zu rels each\n", array_count, R, S, rel_count);
+
+  timer t;
+  timer_start(&t);
+  for (size_t idx = 0; idx < array_count; ++idx)
+  {
+    nth_array(P, Q, idx, Ps, Qs);
+    for (size_t k = 0; k < rel_count; ++k)
+    {
+      memset(rows, 0, sizeof(rows));
+      memset(cols, 0, sizeof(cols));
+      if (!fall_on_different_line_after_latin_squares(rows, cols, rels + k * N, P, Q, R, S))
+        continue;
+      x_y_rel_after_latin_squares(mapped, rels + k * N, P, Q, R, S);
+      acc_scan += mapped[idx % N] + 1;
+    }
+  }
+  const double scan = timer_stop(&t);
+
+  latin_squares_inv inv;
+  timer_start(&t);
+  for (size_t idx = 0; idx < array_count; ++idx)
+  {
+    nth_array(P, Q, idx, Ps, Qs);
+    latin_squares_inv_compute(&inv, P, Q, R, S);
+    for (size_t k = 0; k < rel_count; ++k)
+    {
+      memset(rows, 0, sizeof(rows));
+      memset(cols, 0, sizeof(cols));
+      if (!fall_on_different_line_after_latin_squares_inv(rows, cols, rels + k * N, &inv))
+        continue;
+      x_y_rel_after_latin_squares_inv(mapped, rels + k * N, &inv);
+      acc_inv += mapped[idx % N] + 1;
+    }
+  }
+  const double tables = timer_stop(&t);
+
+  printf("scan   : %.3fs, %.2f M rels/s\n", scan, array_count * rel_count / scan / 1e6);
+  printf("tables : %.3fs, %.2f M rels/s, x%.2f\n", tables, array_count * rel_count / tables / 1e6, scan / tables);
+
+  if (acc_scan != acc_inv)
+  {
+    fprintf(stderr, "[ERROR] the two mappings disagree: %zu != %zu\n", acc_scan, acc_inv);
+    return 1;
+  }
+
+  free(rels);
+  return 0;
+}
+
+// the timer implementation comes with taxicab.o
+#define NOB_IMPLEMENTATION
+#include "nob.h"
+#define __PERF_COUNTER_IMPLEMENTATION__
+#include "perf_counter.h"
@@ -13,6 +13,7 @@
 #include "permut.h"
 #include "pow_m_sqr.h"
 #include "taxicab.h"
+#include "find_latin_squares.h"
 
 // Include test data
 #include "know/16x16x4.h"
@@ -69,6 +70,22 @@ TEST(rels_are_disjoint_truly_disjoint) {
     ASSERT_TRUE(result);
 }
 
+TEST(packed_x_y_rels_are_disjoint_matches_rels_are_disjoint) {
+    uint64_t w1[PACKED_X_Y_REL_WORDS], w2[PACKED_X_Y_REL_WORDS];
+    pack_x_y_rel(w1, rel1, 16);
+    pack_x_y_rel(w2, rel2, 16);
+    ASSERT_TRUE(packed_x_y_rels_are_disjoint(w1, w2, 16));
+    ASSERT_FALSE(packed_x_y_rels_are_disjoint(w1, w1, 16));
+
+    // the only shared entry is the last one: the bytes past n must not hide it nor add one
+    rel_item arr1[] = {0, 2, 1, 3, 4, 5, 6, 7, 8};
+    rel_item arr2[] = {1, 0, 2, 4, 3, 6, 7, 5, 8};
+    pack_x_y_rel(w1, arr1, 9);
+    pack_x_y_rel(w2, arr2, 9);
+    ASSERT_EQUAL(rels_are_disjoint(arr1, arr2, 9), packed_x_y_rels_are_disjoint(w1, w2, 9));
+    ASSERT_EQUAL(rels_are_disjoint(arr1, arr2, 8), packed_x_y_rels_are_disjoint(w1, w2, 8));
+}
+
 /* ============================================================
  * Tests for rels_are_diagonizable
  * ============================================================ */
@@ -192,6 +209,21 @@ TEST(position_after_latin_square_permutation_simple) {
     ASSERT_TRUE(new_col < 4);
 }
 
+TEST(position_after_latin_square_permutation_inv_matches_scan) {
+    latin_squares_inv inv;
+    latin_squares_inv_compute(&inv, P, Q, r, s);
+
+    for (uint32_t i = 0; i < r * s; ++i) {
+        for (uint32_t j = 0; j < r * s; ++j) {
+            uint32_t row, col, row_inv, col_inv;
+            position_after_latin_square_permutation(&row, &col, i, j, P, Q, r, s);
+            position_after_latin_square_permutation_inv(&row_inv, &col_inv, i, j, &inv);
+            ASSERT_EQUAL(row, row_inv);
+            ASSERT_EQUAL(col, col_inv);
+        }
+    }
+}
+
 /* ============================================================
  * Tests for fall_on_different_line_after_latin_squares
  * ============================================================ */
@@ -224,6 +256,153 @@ TEST(fall_on_different_line_collision) {
     (void)result;
 }
 
+TEST(x_y_rel_after_latin_squares_inv_checked_matches_two_passes) {
+    latin_squares_inv inv;
+    latin_squares_inv_compute(&inv, P, Q, r, s);
+    const uint32_t n = r * s;
+
+    // the main diagonal, and the same diagonal with a shift of one column per row
+    rel_item poses[2][16];
+    for (uint32_t i = 0; i < n; ++i) {
+        poses[0][i] = i * n + i;
+        poses[1][i] = i * n + (i + 1) % n;
+    }
+
+    for (uint32_t k = 0; k < 2; ++k) {
+        uint8_t rows[16] = {0}, cols[16] = {0};
+        uint8_t rows_checked[16] = {0}, cols_checked[16] = {0};
+        rel_item expected[16] = {0}, got[16] = {0};
+
+        const uint8_t different = fall_on_different_line_after_latin_squares_inv(rows, cols, poses[k], &inv);
+        ASSERT_EQUAL(different, x_y_rel_after_latin_squares_inv_checked(got, rows_checked, cols_checked, poses[k], &inv));
+        if (different) {
+            x_y_rel_after_latin_squares_inv(expected, poses[k], &inv);
+            ASSERT_TRUE(memcmp(expected, got, n * sizeof(rel_item)) == 0);
+        }
+    }
+}
+
+/* ============================================================
+ * Tests for latin_square_array_canonicalize
+ * ============================================================ */
+
+static int compare_canonical_keys(const void *a, const void *b) {
+    return memcmp(a, b, 3 * 16 + 4 * 9);
+}
+
+/*
+ * brute force on every 3x4 array: shuffling the columns of the squares gives back the array through
+ * latin_square_array_canonicalize and only relabels the lines of the mapped rels, while no relabeling
+ * of the lines merges two different arrays
+ */
+TEST(latin_square_array_canonicalize_classes_3x4) {
+    const uint32_t R = 3, S = 4, N = R * S;
+    const size_t array_size = R * S*S + S * R*R;
+    const size_t count = number_of_latin_square_arrays(R, S);
+    ASSERT_EQUAL(count, (size_t)24 * 24 * 24 * 2 * 2 * 2 * 2);
+
+    // the diagonals with every shift, and a scrambled one
+    rel_item poses[13][12];
+    for (uint32_t k = 0; k < N; ++k)
+        for (uint32_t i = 0; i < N; ++i)
+            poses[k][i] = i * N + (i + k) % N;
+    for (uint32_t i = 0; i < N; ++i)
+        poses[N][i] = i * N + (5 * i + 7) % N;
+
+    uint8_t *keys = malloc(count * array_size);
+    ASSERT_TRUE(keys != NULL);
+    srand(42);
+
+    for (size_t idx = 0; idx < count; ++idx) {
+        uint8_t array[3 * 16 + 4 * 9], shuffled[3 * 16 + 4 * 9];
+        latin_square_array_unrank(array, idx, R, S);
+
+        // shuffle the columns of every square
+        memcpy(shuffled, array, array_size);
+        for (uint32_t k = 0; k < R + S; ++k) {
+            const uint32_t n = k < R ? S : R;
+            uint8_t *sq = shuffled + (k < R ? k * S*S : R * S*S + (k - R) * R*R);
+            for (uint32_t c = n - 1; c > 0; --c) {
+                const uint32_t o = rand() % (c + 1);
+                for (uint32_t row = 0; row < n; ++row) {
+                    const uint8_t t = sq[row * n + c];
+                    sq[row * n + c] = sq[row * n + o];
+                    sq[row * n + o] = t;
+                }
+            }
+        }
+
+        latin_squares_inv inv, inv_shuffled;
+        latin_squares_inv_compute_from_array(&inv, array, R, S);
+        latin_squares_inv_compute_from_array(&inv_shuffled, shuffled, R, S);
+
+        rel_item row_relabel[12], col_relabel[12];
+        latin_square_array_canonicalize(shuffled, row_relabel, col_relabel, R, S);
+        ASSERT_TRUE(memcmp(shuffled, array, array_size) == 0);
+
+        for (uint32_t k = 0; k <= N; ++k) {
+            uint8_t rows[12] = {0}, cols[12] = {0}, rows_shuffled[12] = {0}, cols_shuffled[12] = {0};
+            rel_item ret[12], ret_shuffled[12];
+            const uint8_t different = x_y_rel_after_latin_squares_inv_checked(ret, rows, cols, poses[k], &inv);
+            ASSERT_EQUAL(different, x_y_rel_after_latin_squares_inv_checked(ret_shuffled, rows_shuffled, cols_shuffled, poses[k], &inv_shuffled));
+            if (different)
+                for (uint32_t row = 0; row < N; ++row)
+                    ASSERT_EQUAL(ret_shuffled[row_relabel[row]], col_relabel[ret[row]]);
+        }
+
+        /*
+         * the cells of the block (i, 0) (resp. (0, j)) all stay in their line: the relabelings which send a cell map
+         * to another one are pinned by these blocks, the key is the cell map with them made the identity
+         */
+        uint8_t *key = keys + idx * array_size;
+        uint8_t pin[4];
+        for (uint32_t i = 0; i < S; ++i) {
+            for (uint32_t u = 0; u < R; ++u)
+                pin[inv.Q_map[(i * R + 0) * R + u]] = u;
+            for (uint32_t j = 0; j < R; ++j)
+                for (uint32_t u = 0; u < R; ++u)
+                    key[(i * R + j) * R + u] = pin[inv.Q_map[(i * R + j) * R + u]];
+        }
+        for (uint32_t j = 0; j < R; ++j) {
+            for (uint32_t v = 0; v < S; ++v)
+                pin[inv.P_map[(j * S + 0) * S + v]] = v;
+            for (uint32_t i = 0; i < S; ++i)
+                for (uint32_t v = 0; v < S; ++v)
+                    key[S * R * R + (j * S + i) * S + v] = pin[inv.P_map[(j * S + i) * S + v]];
+        }
+    }
+
+    qsort(keys, count, array_size, compare_canonical_keys);
+    for (size_t idx = 1; idx < count; ++idx)
+        ASSERT_TRUE(memcmp(keys + (idx - 1) * array_size, keys + idx * array_size, array_size) != 0);
+
+    free(keys);
+}
+
+/* ============================================================
+ * Tests for latin_square_rank / latin_square_unrank
+ * ============================================================ */
+
+TEST(latin_square_rank_unrank_round_trip) {
+    for (uint32_t n = 1; n <= 5; ++n) {
+        const latin_square_list *table = latin_square_table(n);
+        ASSERT_EQUAL(table->count, (size_t)A000479[n]);
+
+        latin_square P;
+        latin_square_init(&P, n);
+        for (size_t k = 0; k < table->count; ++k) {
+            latin_square_unrank(&P, k);
+            ASSERT_EQUAL(latin_square_rank(&P), k);
+        }
+
+        // not a latin square: one past the last rank
+        memset(P.arr, 0, n * n);
+        if (n > 1)
+            ASSERT_EQUAL(latin_square_rank(&P), table->count);
+        latin_square_clear(&P);
+    }
+}
+
 /* ============================================================
  * Tests for permute_into_pow_m_sqr (integration test)
  * ============================================================ */
@@ -296,6 +475,7 @@ int main(void) {
     RUN_TEST(rels_are_disjoint_same_array);
     RUN_TEST(rels_are_disjoint_simple_case);
     RUN_TEST(rels_are_disjoint_truly_disjoint);
+    RUN_TEST(packed_x_y_rels_are_disjoint_matches_rels_are_disjoint);
 
     /* rels_are_diagonizable tests */
     RUN_TEST(rels_are_diagonizable_with_16x16_data);
@@ -307,10 +487,18 @@ int main(void) {
     RUN_TEST(position_after_latin_square_permutation_basic);
     RUN_TEST(position_after_latin_square_permutation_all_positions);
     RUN_TEST(position_after_latin_square_permutation_simple);
+    RUN_TEST(position_after_latin_square_permutation_inv_matches_scan);
 
     /* fall_on_different_line_after_latin_squares tests */
     RUN_TEST(fall_on_different_line_basic);
     RUN_TEST(fall_on_different_line_collision);
+    RUN_TEST(x_y_rel_after_latin_squares_inv_checked_matches_two_passes);
+
+    /* latin_square_array_canonicalize tests */
+    RUN_TEST(latin_square_array_canonicalize_classes_3x4);
+
+    /* latin_square_rank / latin_square_unrank tests */
+    RUN_TEST(latin_square_rank_unrank_round_trip);
 
     /* permute_into_pow_m_sqr integration tests */
     RUN_TEST(permute_into_pow_m_sqr_integration);